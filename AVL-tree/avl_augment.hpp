@@ -0,0 +1,83 @@
+#ifndef AVL_AUGMENT_HPP
+#define AVL_AUGMENT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ds {
+
+/*
+ * Augmentation policies for AVLTree_Base.
+ *
+ * A policy provides:
+ * 1. node_data<T> - Extra per node fields, mixed into AVLNode<T>.
+ *    An empty node_data costs no space (empty base).
+ * 2. update(node, left, right) - Recomputes the fields of `node`
+ *    from its children (nullptr for a missing child). The tree
+ *    calls it wherever it recomputes a height, i.e after every
+ *    rotation and on the way back up from insert/erase.
+ * 3. update_ancestors - true if an insert/erase changes the fields
+ *    of every ancestor even after the heights have settled, so
+ *    that retracing must continue up to the head.
+ */
+
+struct avl_no_augment
+{
+  template <typename T>
+  struct node_data {};
+
+  static constexpr bool update_ancestors = false;
+
+  template <typename Node>
+  static void update(Node&, const Node*, const Node*) noexcept {}
+};
+
+/*
+ * Subtree size, for O(log n) rank/select/count_range.
+ */
+struct avl_subtree_size
+{
+  template <typename T>
+  struct node_data {
+    uint32_t subtree_size_ = 1;
+  };
+
+  static constexpr bool update_ancestors = true;
+
+  template <typename Node>
+  static void update(Node& node, const Node* left, const Node* right) noexcept {
+    node.augment().subtree_size_ = 1 + size(left) + size(right);
+  }
+
+  template <typename Node>
+  static size_t size(const Node* node) noexcept {
+    return node ? node->augment().subtree_size_ : 0;
+  }
+};
+
+/*
+ * Largest interval end in the subtree, for overlap queries.
+ * Keys are intervals std::pair<lo, hi>, half open [lo, hi),
+ * ordered by lo first. Ends are compared with operator<.
+ */
+struct avl_interval_max
+{
+  template <typename T>
+  struct node_data {
+    typename T::first_type::second_type max_end_{};
+  };
+
+  static constexpr bool update_ancestors = true;
+
+  template <typename Node>
+  static void update(Node& node, const Node* left, const Node* right) {
+    auto max_end = node.key().second;
+    if (left && max_end < left->augment().max_end_) max_end = left->augment().max_end_;
+    if (right && max_end < right->augment().max_end_) max_end = right->augment().max_end_;
+    node.augment().max_end_ = max_end;
+  }
+};
+
+}// end namespace ds
+
+#endif
@@ -1,189 +1,829 @@
 #include "avl_tree.hpp"
 using namespace ds;
 
-template <typename K, typename V, typename Comp>
-bool AVLTree_Base<K, V, Comp>::insert(const value_type& value)
+template <typename K, typename V, typename Comp, typename Aug>
+constexpr typename AVLTree_Base<K, V, Comp, Aug>::index_type
+AVLTree_Base<K, V, Comp, Aug>::null_index;
+
+template <typename K, typename V, typename Comp, typename Aug>
+constexpr size_t AVLTree_Base<K, V, Comp, Aug>::max_height;
+
+template <typename K, typename V, typename Comp, typename Aug>
+bool AVLTree_Base<K, V, Comp, Aug>::insert(const value_type& value)
 {
-  if (head_ == nullptr) {
-    head_ = new NodeType(value);
-    return true;
-  }
-  auto tnode = do_insert(head_, value);
-  if (!tnode) {
-    return false;
+  index_type path[max_height];
+  bool went_left[max_height];
+  size_t depth = 0;
+
+  index_type idx = head_;
+  while (idx != null_index) {
+    const NodeType& n = node(idx);
+    path[depth] = idx;
+    if (compare_(value.first, n.key())) {
+      went_left[depth++] = true;
+      idx = n.left();
+    } else if (compare_(n.key(), value.first)) {
+      went_left[depth++] = false;
+      idx = n.right();
+    } else {
+      return false;
+    }
   }
-  if (tnode != head_) head_ = tnode;
+
+  auto leaf = pool_.create(value);
+  // Leaf fields of the augmentation, e.g its own interval end
+  adjust_height(leaf);
+  relink(path, went_left, depth, leaf);
+  size_++;
+  retrace(path, went_left, depth);
   return true;
 }
 
-template <typename K, typename V, typename Comp>
-auto AVLTree_Base<K, V, Comp>::
-do_insert(NodeTypePtr node, const value_type& value)
-  -> NodeTypePtr 
+template <typename K, typename V, typename Comp, typename Aug>
+bool AVLTree_Base<K, V, Comp, Aug>::erase(const key_type& key)
 {
-  assert (node);
-  if (node->key() == value.first) return nullptr;
-  NodeTypePtr ret_node = nullptr;
+  index_type path[max_height];
+  bool went_left[max_height];
+  size_t depth = 0;
 
-  if (compare_(value.second, node->key())) {
-    if (!node->left()) {
-      node->left(new NodeType(value));
-      node->adjust_height();
-      return node;
+  index_type idx = head_;
+  while (idx != null_index) {
+    const NodeType& n = node(idx);
+    if (compare_(key, n.key())) {
+      path[depth] = idx;
+      went_left[depth++] = true;
+      idx = n.left();
+    } else if (compare_(n.key(), key)) {
+      path[depth] = idx;
+      went_left[depth++] = false;
+      idx = n.right();
+    } else {
+      break;
     }
-    ret_node = do_insert(node->left(), value);
-    if (ret_node != node->left()) node->left(ret_node);
+  }
+  if (idx == null_index) return false;
+
+  NodeType& target = node(idx);
+  if (target.left() == null_index || target.right() == null_index) {
+    relink(path, went_left, depth,
+           target.left() != null_index ? target.left() : target.right());
   } else {
-    if (!node->right()) {
-      node->right(new NodeType(value));
-      node->adjust_height();
-      return node;
-    }
-    ret_node = do_insert(node->right(), value);
-    if (ret_node != node->right()) node->right(ret_node);
-  }
-  // Adjust the height
-  node->adjust_height();
-
-  if (ret_node) {
-    auto ht = node->subtree_heights();
-    if (ht.first > ht.second && (ht.first - ht.second) > 1) {
-      return do_left_rotate(node);
-    } else if (ht.second > ht.first && (ht.second - ht.first) > 1) {
-      return do_right_rotate(node);
+    // Splice the in-order successor into the place of `target`
+    // rather than copying values around.
+    const size_t target_depth = depth;
+    path[depth] = idx;
+    went_left[depth++] = false;
+
+    index_type succ = target.right();
+    while (node(succ).left() != null_index) {
+      path[depth] = succ;
+      went_left[depth++] = true;
+      succ = node(succ).left();
     }
-  } else {
-    return nullptr;
+    relink(path, went_left, depth, node(succ).right());
+
+    NodeType& s = node(succ);
+    s.left(target.left());
+    s.right(target.right());
+    s.height(target.height());
+    path[target_depth] = succ;
+    relink(path, went_left, target_depth, succ);
   }
-  return node;
+
+  pool_.destroy(idx);
+  size_--;
+  retrace(path, went_left, depth);
+  return true;
 }
 
-template <typename K, typename V, typename Comp>
-auto AVLTree_Base<K, V, Comp>::do_left_rotate(NodeTypePtr node)
-  -> NodeTypePtr
+template <typename K, typename V, typename Comp, typename Aug>
+void AVLTree_Base<K, V, Comp, Aug>::
+relink(const index_type* path, const bool* went_left,
+       size_t depth, index_type child) noexcept
 {
-  assert (node);
-  auto left_child = node->left();
-  assert (left_child);
-  auto ht = left_child->subtree_heights();
-  if (ht.first > ht.second) {
-    return do_left_left_rotate(node);
+  if (depth == 0) {
+    head_ = child;
+  } else if (went_left[depth - 1]) {
+    node(path[depth - 1]).left(child);
   } else {
-    return do_left_right_rotate(node);
+    node(path[depth - 1]).right(child);
+  }
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+void AVLTree_Base<K, V, Comp, Aug>::
+retrace(index_type* path, const bool* went_left, size_t depth)
+{
+  while (depth > 0) {
+    auto idx = path[--depth];
+    auto old_ht = node(idx).height();
+    auto top = rebalance(idx);
+    if (top != idx) {
+      relink(path, went_left, depth, top);
+      path[depth] = top;
+    }
+    // Heights above this point cannot change any more
+    if (node(top).height() == old_ht) break;
+  }
+
+  // but e.g subtree sizes still do
+  if (Aug::update_ancestors) {
+    while (depth > 0) adjust_height(path[--depth]);
+  }
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::rebalance(index_type idx)
+  -> index_type
+{
+  adjust_height(idx);
+  auto ht = subtree_heights(idx);
+  if (ht.first > ht.second + 1) {
+    return do_left_rotate(idx);
+  } else if (ht.second > ht.first + 1) {
+    return do_right_rotate(idx);
+  }
+  return idx;
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+const V* AVLTree_Base<K, V, Comp, Aug>::find(const key_type& key) const
+{
+  index_type idx = head_;
+  while (idx != null_index) {
+    const NodeType& n = node(idx);
+    if (compare_(key, n.key())) {
+      idx = n.left();
+    } else if (compare_(n.key(), key)) {
+      idx = n.right();
+    } else {
+      return &n.value().second;
+    }
+  }
+  return nullptr;
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+FrozenAVLTree<K, V, Comp> AVLTree_Base<K, V, Comp, Aug>::freeze() const
+{
+  std::vector<value_type> sorted;
+  sorted.reserve(size_);
+
+  // Iterative in order walk
+  index_type path[max_height];
+  size_t depth = 0;
+  index_type idx = head_;
+  while (idx != null_index || depth > 0) {
+    while (idx != null_index) {
+      path[depth++] = idx;
+      idx = node(idx).left();
+    }
+    idx = path[--depth];
+    sorted.push_back(node(idx).value());
+    idx = node(idx).right();
+  }
+  return FrozenAVLTree<K, V, Comp>(sorted.begin(), sorted.end());
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+template <typename F>
+void AVLTree_Base<K, V, Comp, Aug>::
+for_each_in_range(const key_type& lo, const key_type& hi, F&& f) const
+{
+  do_for_each_in_range(head_, lo, hi, f);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+template <typename F>
+void AVLTree_Base<K, V, Comp, Aug>::
+do_for_each_in_range(index_type idx, const key_type& lo,
+                     const key_type& hi, F& f) const
+{
+  if (idx == null_index) return;
+  const NodeType& n = node(idx);
+  bool above_lo = !compare_(n.key(), lo);
+  bool below_hi = compare_(n.key(), hi);
+
+  if (compare_(lo, n.key())) do_for_each_in_range(n.left(), lo, hi, f);
+  if (above_lo && below_hi) f(n.key(), n.value().second);
+  if (below_hi) do_for_each_in_range(n.right(), lo, hi, f);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+size_t AVLTree_Base<K, V, Comp, Aug>::rank(const key_type& key) const
+{
+  static_assert (std::is_same<Aug, avl_subtree_size>::value,
+                 "rank() needs the avl_subtree_size augmentation");
+  size_t rnk = 0;
+  index_type idx = head_;
+  while (idx != null_index) {
+    const NodeType& n = node(idx);
+    if (compare_(n.key(), key)) {
+      rnk += avl_subtree_size::size(child(n.left())) + 1;
+      idx = n.right();
+    } else {
+      idx = n.left();
+    }
+  }
+  return rnk;
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::select(size_t k) const
+  -> const value_type*
+{
+  static_assert (std::is_same<Aug, avl_subtree_size>::value,
+                 "select() needs the avl_subtree_size augmentation");
+  if (k >= size_) return nullptr;
+  index_type idx = head_;
+  while (idx != null_index) {
+    const NodeType& n = node(idx);
+    auto left_size = avl_subtree_size::size(child(n.left()));
+    if (k < left_size) {
+      idx = n.left();
+    } else if (k == left_size) {
+      return &n.value();
+    } else {
+      k -= left_size + 1;
+      idx = n.right();
+    }
   }
   assert (0);
-  return node;
+  return nullptr;
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+size_t AVLTree_Base<K, V, Comp, Aug>::
+count_range(const key_type& lo, const key_type& hi) const
+{
+  if (!compare_(lo, hi)) return 0;
+  return rank(hi) - rank(lo);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+template <typename EndT, typename F>
+void AVLTree_Base<K, V, Comp, Aug>::
+overlapping(const EndT& lo, const EndT& hi, F&& f) const
+{
+  static_assert (std::is_same<Aug, avl_interval_max>::value,
+                 "overlapping() needs the avl_interval_max augmentation");
+  if (!(lo < hi)) return;
+  do_overlapping(head_, lo, hi, f);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+template <typename EndT, typename F>
+void AVLTree_Base<K, V, Comp, Aug>::
+do_overlapping(index_type idx, const EndT& lo, const EndT& hi, F& f) const
+{
+  if (idx == null_index) return;
+  const NodeType& n = node(idx);
+  // Everything below ends at or before lo
+  if (!(lo < n.augment().max_end_)) return;
+
+  do_overlapping(n.left(), lo, hi, f);
+  // Else this node and its right subtree start at or after hi
+  if (n.key().first < hi) {
+    if (lo < n.key().second) f(n.key(), n.value().second);
+    do_overlapping(n.right(), lo, hi, f);
+  }
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+void AVLTree_Base<K, V, Comp, Aug>::clear()
+{
+  // Trivially destructible nodes need not be visited at all
+  if (!std::is_trivially_destructible<NodeType>::value) {
+    destroy_subtree(head_);
+  }
+  pool_.release();
+  head_ = null_index;
+  size_ = 0;
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+void AVLTree_Base<K, V, Comp, Aug>::destroy_subtree(index_type idx) noexcept
+{
+  if (idx == null_index) return;
+  destroy_subtree(node(idx).left());
+  destroy_subtree(node(idx).right());
+  pool_.destroy(idx);
 }
 
-template <typename K, typename V, typename Comp>
-auto AVLTree_Base<K, V, Comp>::do_right_rotate(NodeTypePtr node)
-  -> NodeTypePtr
+// Called when the left subtree of `idx` is two levels taller
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::do_left_rotate(index_type idx)
+  -> index_type
 {
-  assert (node);
-  auto right_child = node->right();
-  assert (right_child);
-  auto ht = right_child->subtree_heights();
-  if (ht.second > ht.first) {
-    return do_right_right_rotate(node);
+  assert (idx != null_index);
+  auto left_child = node(idx).left();
+  assert (left_child != null_index);
+  auto ht = subtree_heights(left_child);
+  // A balanced left child only shows up on erase and
+  // needs the single rotation
+  if (ht.first >= ht.second) {
+    return do_left_left_rotate(idx);
   } else {
-    return do_right_left_rotate(node);
+    return do_left_right_rotate(idx);
   }
+}
 
-  assert (0);
-  return node;
+// Called when the right subtree of `idx` is two levels taller
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::do_right_rotate(index_type idx)
+  -> index_type
+{
+  assert (idx != null_index);
+  auto right_child = node(idx).right();
+  assert (right_child != null_index);
+  auto ht = subtree_heights(right_child);
+  if (ht.second >= ht.first) {
+    return do_right_right_rotate(idx);
+  } else {
+    return do_right_left_rotate(idx);
+  }
 }
 
-template <typename K, typename V, typename Comp>
-auto AVLTree_Base<K, V, Comp>::do_left_left_rotate(NodeTypePtr node)
-  -> NodeTypePtr
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::do_left_left_rotate(index_type idx)
+  -> index_type
 {
-  assert (node);
-  auto left_child = node->left();
-  assert (left_child);
+  assert (idx != null_index);
+  auto left_child = node(idx).left();
+  assert (left_child != null_index);
 
-  // Make `node` right child of left_child
-  node->left(left_child->right());
-  left_child->right(node);
+  // Make `idx` right child of left_child
+  node(idx).left(node(left_child).right());
+  node(left_child).right(idx);
 
   // Adjust heights
-  node->adjust_height();
-  left_child->adjust_height();
+  adjust_height(idx);
+  adjust_height(left_child);
 
   return left_child;
 }
 
-template <typename K, typename V, typename Comp>
-auto AVLTree_Base<K, V, Comp>::do_right_right_rotate(NodeTypePtr node)
-   -> NodeTypePtr
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::do_right_right_rotate(index_type idx)
+   -> index_type
 {
-  assert (node);
-  auto right_child = node->right();
-  assert (right_child);
+  assert (idx != null_index);
+  auto right_child = node(idx).right();
+  assert (right_child != null_index);
 
-  //Make node left child of right_child
-  node->as_leaf();
-  percolate_down_left(right_child, node);
-  right_child->adjust_height();
+  // Make `idx` left child of right_child
+  node(idx).right(node(right_child).left());
+  node(right_child).left(idx);
+
+  // Adjust heights
+  adjust_height(idx);
+  adjust_height(right_child);
 
   return right_child;
 }
 
-template <typename K, typename V, typename Comp>
-auto AVLTree_Base<K, V, Comp>::do_left_right_rotate(NodeTypePtr node)
-  -> NodeTypePtr
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::do_left_right_rotate(index_type idx)
+  -> index_type
 {
-  assert (node);
-  auto left_child = node->left();
-  assert (left_child);
+  assert (idx != null_index);
+  auto left_child = node(idx).left();
+  assert (left_child != null_index);
 
-  //promote right child of the left_child
-  auto rl_child = left_child->right();
-  assert (rl_child);
+  // Promote right child of the left_child, then rotate as left-left
+  node(idx).left(do_right_right_rotate(left_child));
+  return do_left_left_rotate(idx);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::do_right_left_rotate(index_type idx)
+  -> index_type
+{
+  assert (idx != null_index);
+  auto right_child = node(idx).right();
+  assert (right_child != null_index);
 
-  // Make it the leaf node
-  left_child->as_leaf();
-  percolate_down_left(rl_child, left_child);
+  // Promote left child of the right_child, then rotate as right-right
+  node(idx).right(do_left_left_rotate(right_child));
+  return do_right_right_rotate(idx);
+}
+
+//==============================================================================
+// Bulk build and join based operations
 
-  //adjust height
-  rl_child->adjust_height();
-  node->left(rl_child);
-  node->adjust_height();
+template <typename K, typename V, typename Comp, typename Aug>
+constexpr uint32_t AVLTree_Base<K, V, Comp, Aug>::parallel_height;
 
-  return do_left_left_rotate(node);
+template <typename K, typename V, typename Comp, typename Aug>
+template <typename Iter>
+void AVLTree_Base<K, V, Comp, Aug>::build_from_sorted(Iter first, Iter last)
+{
+  assert (std::adjacent_find(first, last,
+            [this](const value_type& a, const value_type& b) {
+              return !compare_(a.first, b.first);
+            }) == last);
+  clear();
+  size_t n = std::distance(first, last);
+  head_ = do_build(first, n);
+  size_ = n;
 }
 
-template <typename K, typename V, typename Comp>
-auto AVLTree_Base<K, V, Comp>::do_right_left_rotate(NodeTypePtr node)
-  -> NodeTypePtr
+template <typename K, typename V, typename Comp, typename Aug>
+template <typename Iter>
+size_t AVLTree_Base<K, V, Comp, Aug>::insert_batch(Iter first, Iter last)
 {
-  assert (node);
-  auto right_child = node->right();
-  assert (right_child);
+  std::vector<value_type> batch(first, last);
+  auto less = [this](const value_type& a, const value_type& b) {
+    return compare_(a.first, b.first);
+  };
+  // Stable, so that unique keeps the first of equal keys
+  std::stable_sort(batch.begin(), batch.end(), less);
+  batch.erase(std::unique(batch.begin(), batch.end(),
+                          [&less](const value_type& a, const value_type& b) {
+                            return !less(a, b);
+                          }),
+              batch.end());
+  if (batch.empty()) return 0;
 
-  auto lr_child = right_child->left();
-  assert (lr_child);
+  size_t inserted = 0;
+  head_ = do_insert_batch(head_, batch.data(), batch.data() + batch.size(), inserted);
+  size_ += inserted;
+  return inserted;
+}
 
-  right_child->left(lr_child->right());
-  lr_child->right(right_child);
-  node->right(lr_child);
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::
+do_insert_batch(index_type idx, const value_type* first,
+                const value_type* last, size_t& inserted) -> index_type
+{
+  if (first == last) return idx;
+  if (idx == null_index) {
+    size_t n = last - first;
+    inserted += n;
+    return do_build(first, n);
+  }
 
-  right_child->adjust_height();
-  lr_child->adjust_height();
-  node->adjust_height();
+  NodeType& n = node(idx);
+  const value_type* mid = std::lower_bound(first, last, n.key(),
+      [this](const value_type& v, const key_type& key) {
+        return compare_(v.first, key);
+      });
+  // Already present key
+  const value_type* upper = (mid != last && !compare_(n.key(), mid->first)) ? mid + 1 : mid;
 
-  return do_right_right_rotate(node);
+  // Only the key of this node was in the batch
+  if (first == mid && upper == last) return idx;
+
+  auto l = do_insert_batch(n.left(), first, mid, inserted);
+  auto r = do_insert_batch(n.right(), upper, last, inserted);
+  return do_join(l, idx, r);
 }
 
-template <typename K, typename V, typename Comp>
-void AVLTree_Base<K, V, Comp>::
-percolate_down_left(NodeTypePtr top, NodeTypePtr leaf)
+// Builds a perfectly balanced tree of the next n elements, nodes
+// are created in key order
+template <typename K, typename V, typename Comp, typename Aug>
+template <typename Iter>
+auto AVLTree_Base<K, V, Comp, Aug>::do_build(Iter& it, size_t n)
+  -> index_type
 {
-  assert (top && leaf);
-  if (!top->left()) {
-    top->left(leaf);
-    top->adjust_height();
+  if (n == 0) return null_index;
+  auto left = do_build(it, n / 2);
+  auto idx = pool_.create(*it);
+  ++it;
+  auto right = do_build(it, n - n / 2 - 1);
+
+  node(idx).left(left);
+  node(idx).right(right);
+  adjust_height(idx);
+  return idx;
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+void AVLTree_Base<K, V, Comp, Aug>::join(AVLTree_Base& other)
+{
+  if (&other == this || other.head_ == null_index) return;
+  auto total = size_ + other.size_;
+  auto r = adopt(other, nullptr);
+  head_ = do_join2(head_, r);
+  size_ = total;
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+void AVLTree_Base<K, V, Comp, Aug>::
+split(const key_type& key, AVLTree_Base& other)
+{
+  assert (&other != this && other.head_ == null_index);
+  index_type l, r;
+  auto mid = do_split(head_, key, l, r);
+  if (mid != null_index) r = do_join(null_index, mid, r);
+
+  head_ = l;
+  auto before = other.size_;
+  other.head_ = other.move_subtree(*this, r);
+  size_ -= other.size_ - before;
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+void AVLTree_Base<K, V, Comp, Aug>::
+set_union(AVLTree_Base& other, ThreadPool* tp)
+{
+  if (&other == this) return;
+  auto total = size_ + other.size_;
+  auto b = adopt(other, tp);
+  Garbage g;
+  head_ = do_union(head_, b, g, tp);
+  release(g, total);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+void AVLTree_Base<K, V, Comp, Aug>::
+set_intersection(AVLTree_Base& other, ThreadPool* tp)
+{
+  if (&other == this) return;
+  auto total = size_ + other.size_;
+  auto b = adopt(other, tp);
+  Garbage g;
+  head_ = do_intersection(head_, b, g, tp);
+  release(g, total);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+void AVLTree_Base<K, V, Comp, Aug>::
+set_difference(AVLTree_Base& other, ThreadPool* tp)
+{
+  if (&other == this) {
+    clear();
+    return;
+  }
+  auto total = size_ + other.size_;
+  auto b = adopt(other, tp);
+  Garbage g;
+  head_ = do_difference(head_, b, g, tp);
+  release(g, total);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::adopt(AVLTree_Base& other, ThreadPool* tp)
+  -> index_type
+{
+  auto head = other.head_;
+  if (head != null_index) {
+    auto offset = pool_.adopt(other.pool_);
+    head += offset;
+    if (offset != 0) rebase(head, offset, tp);
+  }
+  // The nodes now belong to our pool: only forget them
+  other.head_ = null_index;
+  other.size_ = 0;
+  return head;
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+void AVLTree_Base<K, V, Comp, Aug>::
+rebase(index_type idx, index_type offset, ThreadPool* tp)
+{
+  NodeType& n = node(idx);
+  if (n.left() != null_index) n.left(n.left() + offset);
+  if (n.right() != null_index) n.right(n.right() + offset);
+
+  Garbage unused;
+  fork(tp, n.height(), unused,
+       [&](Garbage&) { if (n.left() != null_index) rebase(n.left(), offset, tp); },
+       [&](Garbage&) { if (n.right() != null_index) rebase(n.right(), offset, tp); });
+}
+
+// Recreates the subtree `idx` of `from` in our pool keeping its shape
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::
+move_subtree(AVLTree_Base& from, index_type idx) -> index_type
+{
+  if (idx == null_index) return null_index;
+  auto left = move_subtree(from, from.node(idx).left());
+  auto right = move_subtree(from, from.node(idx).right());
+
+  auto copy = pool_.create(from.node(idx).value());
+  from.pool_.destroy(idx);
+  node(copy).left(left);
+  node(copy).right(right);
+  adjust_height(copy);
+  size_++;
+  return copy;
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::
+do_join(index_type l, index_type k, index_type r) -> index_type
+{
+  auto hl = height(l), hr = height(r);
+  if (hl > hr + 1) return join_right(l, k, r);
+  if (hr > hl + 1) return join_left(l, k, r);
+
+  node(k).left(l);
+  node(k).right(r);
+  adjust_height(k);
+  return k;
+}
+
+// `l` is the taller one: walk down its right spine to a subtree
+// `r` can be hung next to, then rebalance on the way back up.
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::
+join_right(index_type l, index_type k, index_type r) -> index_type
+{
+  NodeType& n = node(l);
+  if (height(n.right()) <= height(r) + 1) {
+    node(k).left(n.right());
+    node(k).right(r);
+    adjust_height(k);
+    n.right(k);
+  } else {
+    n.right(join_right(n.right(), k, r));
+  }
+  return rebalance(l);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::
+join_left(index_type l, index_type k, index_type r) -> index_type
+{
+  NodeType& n = node(r);
+  if (height(n.left()) <= height(l) + 1) {
+    node(k).left(l);
+    node(k).right(n.left());
+    adjust_height(k);
+    n.left(k);
+  } else {
+    n.left(join_left(l, k, n.left()));
+  }
+  return rebalance(r);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::
+do_join2(index_type l, index_type r) -> index_type
+{
+  if (l == null_index) return r;
+  if (r == null_index) return l;
+  index_type rest;
+  auto k = split_last(l, rest);
+  return do_join(rest, k, r);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::
+split_last(index_type idx, index_type& rest) -> index_type
+{
+  NodeType& n = node(idx);
+  if (n.right() == null_index) {
+    rest = n.left();
+    return idx;
+  }
+  index_type sub;
+  auto last = split_last(n.right(), sub);
+  n.right(sub);
+  rest = rebalance(idx);
+  return last;
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::
+do_split(index_type idx, const key_type& key, index_type& l, index_type& r)
+  -> index_type
+{
+  if (idx == null_index) {
+    l = r = null_index;
+    return null_index;
+  }
+  NodeType& n = node(idx);
+  auto left = n.left(), right = n.right();
+  index_type found;
+
+  if (compare_(key, n.key())) {
+    index_type mid;
+    found = do_split(left, key, l, mid);
+    r = do_join(mid, idx, right);
+  } else if (compare_(n.key(), key)) {
+    index_type mid;
+    found = do_split(right, key, mid, r);
+    l = do_join(left, idx, mid);
+  } else {
+    l = left;
+    r = right;
+    n.as_leaf();
+    adjust_height(idx);
+    found = idx;
+  }
+  return found;
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+template <typename F, typename G>
+void AVLTree_Base<K, V, Comp, Aug>::
+fork(ThreadPool* tp, uint32_t ht, Garbage& g, F&& f, G&& h)
+{
+  if (!tp || tp->size() == 1 || ht < parallel_height) {
+    f(g);
+    h(g);
     return;
   }
-  percolate_down_left(top->left(), leaf);
-  top->adjust_height();
+  Garbage other;
+  tp->fork_join([&] { f(g); }, [&] { h(other); });
+  g.insert(g.end(), other.begin(), other.end());
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::
+do_union(index_type a, index_type b, Garbage& g, ThreadPool* tp)
+  -> index_type
+{
+  if (a == null_index) return b;
+  if (b == null_index) return a;
+
+  NodeType& n = node(a);
+  index_type bl, br;
+  auto dup = do_split(b, n.key(), bl, br);
+  if (dup != null_index) g.push_back(dup);
+
+  auto al = n.left(), ar = n.right();
+  index_type l, r;
+  fork(tp, std::max(n.height(), height(b)), g,
+       [&](Garbage& gl) { l = do_union(al, bl, gl, tp); },
+       [&](Garbage& gr) { r = do_union(ar, br, gr, tp); });
+  return do_join(l, a, r);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::
+do_intersection(index_type a, index_type b, Garbage& g, ThreadPool* tp)
+  -> index_type
+{
+  if (a == null_index || b == null_index) {
+    collect(a, g);
+    collect(b, g);
+    return null_index;
+  }
+
+  NodeType& n = node(a);
+  index_type bl, br;
+  auto dup = do_split(b, n.key(), bl, br);
+
+  auto al = n.left(), ar = n.right();
+  index_type l, r;
+  fork(tp, std::max(n.height(), height(b)), g,
+       [&](Garbage& gl) { l = do_intersection(al, bl, gl, tp); },
+       [&](Garbage& gr) { r = do_intersection(ar, br, gr, tp); });
+
+  if (dup != null_index) {
+    g.push_back(dup);
+    return do_join(l, a, r);
+  }
+  g.push_back(a);
+  return do_join2(l, r);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+auto AVLTree_Base<K, V, Comp, Aug>::
+do_difference(index_type a, index_type b, Garbage& g, ThreadPool* tp)
+  -> index_type
+{
+  if (a == null_index || b == null_index) {
+    collect(b, g);
+    return a;
+  }
+
+  NodeType& n = node(a);
+  index_type bl, br;
+  auto dup = do_split(b, n.key(), bl, br);
+
+  auto al = n.left(), ar = n.right();
+  index_type l, r;
+  fork(tp, std::max(n.height(), height(b)), g,
+       [&](Garbage& gl) { l = do_difference(al, bl, gl, tp); },
+       [&](Garbage& gr) { r = do_difference(ar, br, gr, tp); });
+
+  if (dup != null_index) {
+    g.push_back(dup);
+    g.push_back(a);
+    return do_join2(l, r);
+  }
+  return do_join(l, a, r);
+}
+
+template <typename K, typename V, typename Comp, typename Aug>
+void AVLTree_Base<K, V, Comp, Aug>::
+collect(index_type idx, Garbage& g) const
+{
+  if (idx == null_index) return;
+  g.push_back(idx);
+  collect(node(idx).left(), g);
+  collect(node(idx).right(), g);
+}
+
+// Every node of both inputs either ended up in the result or in `g`
+template <typename K, typename V, typename Comp, typename Aug>
+void AVLTree_Base<K, V, Comp, Aug>::
+release(const Garbage& g, size_t total_nodes)
+{
+  for (auto idx : g) pool_.destroy(idx);
+  size_ = total_nodes - g.size();
 }
@@ -3,15 +3,32 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <iterator>
 #include <type_traits>
+#include <vector>
+#include "avl_augment.hpp"
+#include "frozen_avl_tree.hpp"
+#include "node_pool.hpp"
+#include "../util/thread_pool.hpp"
 
 namespace ds {
 
-template <typename T>
-class AVLNode {
+/*
+ * Children are referred to by 32 bit index into the NodePool
+ * owned by the tree, 0 being the null child. Together with
+ * a one byte height this keeps e.g AVLNode<pair<int,int>>
+ * at 20 bytes instead of 32 with two pointers.
+ * Fields of the augmentation policy (see avl_augment.hpp) are
+ * mixed in as a base, taking no space when the policy has none.
+ */
+template <typename T, typename Augment = avl_no_augment>
+class AVLNode: private Augment::template node_data<T> {
 public:
+  using augment_type = typename Augment::template node_data<T>;
+  using index_type = uint32_t;
+
   AVLNode(const T& value):
     value_(value)
   {}
@@ -19,99 +36,274 @@ public:
   void operator=(const AVLNode&) = delete;
 
 public:
-  const AVLNode* left() const noexcept 
-  { return left_; }
-
-  AVLNode* left() noexcept { return left_; }
-  void left(AVLNode* node) { left_ = node; }
+  index_type left() const noexcept { return left_; }
+  void left(index_type node) noexcept { left_ = node; }
 
-  const AVLNode* right() const noexcept 
-  { return right_; } 
-
-  AVLNode* right() noexcept { return right_; } 
-  void right(AVLNode* node) { right_ = node; }
+  index_type right() const noexcept { return right_; }
+  void right(index_type node) noexcept { right_ = node; }
 
   T& value() noexcept { return value_; }
   const T& value() const noexcept { return value_; }
 
-  const typename T::second_type& key() const noexcept
-  { return value().second; }
+  const typename T::first_type& key() const noexcept
+  { return value().first; }
 
   uint32_t height() const noexcept  { return height_; }
-
-  void adjust_height() noexcept {
-    auto ht = subtree_heights();
-    height_ = std::max(ht.first, ht.second) + 1;
+  void height(uint32_t ht) noexcept {
+    assert (ht <= UINT8_MAX);
+    height_ = static_cast<uint8_t>(ht);
   }
 
-  std::pair<uint32_t, uint32_t>
-  subtree_heights() const noexcept {
-    return std::make_pair(left_subtree_ht(), right_subtree_ht());
-  }
+  augment_type& augment() noexcept { return *this; }
+  const augment_type& augment() const noexcept { return *this; }
 
   void as_leaf() noexcept {
     height_ = 1;
-    left_ = nullptr;
-    right_ = nullptr;
-  }
-
-private:
-  uint32_t left_subtree_ht() const noexcept {
-    return (left() ? left()->height() : 0);
-  }
-  uint32_t right_subtree_ht() const noexcept {
-    return (right() ? right()->height() : 0);
+    left_ = 0;
+    right_ = 0;
   }
 
 private:
   T value_;
-  uint32_t height_ = 1;
-  AVLNode* left_   = nullptr;
-  AVLNode* right_  = nullptr;
+  index_type left_  = 0;
+  index_type right_ = 0;
+  uint8_t height_   = 1;
 };
 
-template <typename KeyT, typename ValueT, 
-	  typename Comparator = std::less<KeyT>>
+/*
+ * @class AVLTree_Base
+ * `Augment` selects the extra per node data kept current through
+ * the rotations, avl_no_augment by default. With avl_subtree_size
+ * the order statistic queries rank()/select()/count_range() are
+ * available in O(log n), with avl_interval_max the overlap query
+ * overlapping(). Reporting k overlaps costs O(log n + k) only when
+ * the hits are adjacent in start order, and O(log n + k log(n/k))
+ * in the worst case.
+ */
+template <typename KeyT, typename ValueT,
+	  typename Comparator = std::less<KeyT>,
+	  typename Augment = avl_no_augment>
 class AVLTree_Base
 {
 public:
   using key_type = KeyT;
   using value_type = std::pair<KeyT, ValueT>;
-  using NodeType = AVLNode<value_type>;
-  using NodeTypePtr = NodeType*;
+  using NodeType = AVLNode<value_type, Augment>;
+  using index_type = typename NodeType::index_type;
+  using PoolType = NodePool<NodeType>;
+
+  static constexpr index_type null_index = PoolType::null_index;
+  // An AVL tree of 2^32 nodes is at most ~46 levels deep
+  static constexpr size_t max_height = 64;
+  // Subtrees at least this high are worth a fork in the set operations
+  static constexpr uint32_t parallel_height = 12;
 
 public:
   AVLTree_Base() = default;
   AVLTree_Base(const AVLTree_Base&) = delete;
   void operator=(const AVLTree_Base&) = delete;
+  ~AVLTree_Base() { clear(); }
 
-  //TODO: change access specifiers 
+  //TODO: change access specifiers
 public:
   bool insert(const value_type& val);
 
-  const NodeTypePtr head() const noexcept {
+  // Returns false if the key is not present
+  bool erase(const key_type& key);
+
+  // Returns nullptr if the key is not present
+  const ValueT* find(const key_type& key) const;
+
+  // Calls f(key, value) for every key in [lo, hi) in ascending order
+  template <typename F>
+  void for_each_in_range(const key_type& lo, const key_type& hi, F&& f) const;
+
+  // Number of keys less than `key`. Needs avl_subtree_size.
+  size_t rank(const key_type& key) const;
+
+  // The k-th smallest (0 based) element or nullptr if k >= size().
+  // Needs avl_subtree_size.
+  const value_type* select(size_t k) const;
+
+  // Number of keys in [lo, hi). Needs avl_subtree_size.
+  size_t count_range(const key_type& lo, const key_type& hi) const;
+
+  /*
+   * Calls f(interval, value) for every interval key overlapping
+   * [lo, hi), ordered by start. Needs avl_interval_max.
+   * Subtrees ending before lo or starting at/after hi are pruned,
+   * so only the paths down to the k hits are walked:
+   * O(log n + k) when the hits are adjacent in start order,
+   * O(log n + k log(n/k)) at worst.
+   */
+  template <typename EndT, typename F>
+  void overlapping(const EndT& lo, const EndT& hi, F&& f) const;
+
+  // Destroys all the nodes and hands the pool memory back at once
+  void clear();
+
+  // Replaces the content with the strictly increasing (by key)
+  // range [first, last) in O(n)
+  template <typename Iter>
+  void build_from_sorted(Iter first, Iter last);
+
+  // Inserts the value_types of [first, last), in any order, in one
+  // top down merge: the batch is sorted, then split around each
+  // node on the way down, subtrees getting no new key are left
+  // untouched and the rest is put back together with join.
+  // O(k log(n/k + 1)) for k keys. As with insert(), keys already
+  // present (or repeated in the batch) keep their first value.
+  // Returns the number of keys inserted.
+  template <typename Iter>
+  size_t insert_batch(Iter first, Iter last);
+
+  /*
+   * Join based operations (Blelloch et al. "Just Join for
+   * Parallel Ordered Sets").
+   * The nodes of `other` are handed over to this tree without
+   * copying: its pool chunks are adopted and the child indices
+   * rebased in one pass. `other` is left empty.
+   */
+
+  // Appends `other` whose keys must all be greater than ours.
+  // O(log n) join after the O(m) rebasing of `other`.
+  void join(AVLTree_Base& other);
+
+  // Moves every key not less than `key` into the empty tree `other`.
+  // The split itself is O(log n), moving the upper part into the
+  // pool of `other` is linear in its size.
+  void split(const key_type& key, AVLTree_Base& other);
+
+  // Set algebra with `other`, forking subproblems onto `tp` when
+  // given. For keys in both trees the value in this tree is kept.
+  void set_union(AVLTree_Base& other, ThreadPool* tp = nullptr);
+  void set_intersection(AVLTree_Base& other, ThreadPool* tp = nullptr);
+  void set_difference(AVLTree_Base& other, ThreadPool* tp = nullptr);
+
+  // Read only copy in a cache friendly array layout, for lookups
+  // once the tree is done changing. See FrozenAVLTree.
+  FrozenAVLTree<KeyT, ValueT, Comparator> freeze() const;
+
+  size_t size() const noexcept { return size_; }
+
+  index_type head() const noexcept {
     return head_;
   }
+
+  const NodeType& node(index_type idx) const noexcept {
+    assert (idx != null_index);
+    return pool_[idx];
+  }
+
+  uint32_t height(index_type idx) const noexcept {
+    return idx == null_index ? 0 : pool_[idx].height();
+  }
+
+  std::pair<uint32_t, uint32_t>
+  subtree_heights(index_type idx) const noexcept {
+    return std::make_pair(height(node(idx).left()), height(node(idx).right()));
+  }
+
 private:
-  NodeTypePtr do_insert(NodeTypePtr node,
-		        const value_type& value);
+  NodeType& node(index_type idx) noexcept {
+    assert (idx != null_index);
+    return pool_[idx];
+  }
+
+  const NodeType* child(index_type idx) const noexcept {
+    return idx == null_index ? nullptr : &pool_[idx];
+  }
+
+  // Recomputes the height and augmented data from the children
+  void adjust_height(index_type idx) noexcept {
+    auto ht = subtree_heights(idx);
+    NodeType& n = node(idx);
+    n.height(std::max(ht.first, ht.second) + 1);
+    Augment::update(n, child(n.left()), child(n.right()));
+  }
+
+  // Stores `child` in the slot of the parent which path[depth]
+  // hangs off, i.e path[depth - 1] or the head for depth 0
+  void relink(const index_type* path, const bool* went_left,
+              size_t depth, index_type child) noexcept;
 
-  NodeTypePtr do_right_rotate(NodeTypePtr node);
-  NodeTypePtr do_left_rotate(NodeTypePtr node);
-  NodeTypePtr do_left_left_rotate(NodeTypePtr node);
-  NodeTypePtr do_left_right_rotate(NodeTypePtr node);
-  NodeTypePtr do_right_left_rotate(NodeTypePtr node);
-  NodeTypePtr do_right_right_rotate(NodeTypePtr node);
+  // Walks up `path` from `depth - 1` restoring the balance and
+  // stops as soon as a subtree keeps its old height
+  void retrace(index_type* path, const bool* went_left, size_t depth);
 
-  void percolate_down_left(NodeTypePtr top, NodeTypePtr leaf);
+  index_type rebalance(index_type node);
+  index_type do_right_rotate(index_type node);
+  index_type do_left_rotate(index_type node);
+  index_type do_left_left_rotate(index_type node);
+  index_type do_left_right_rotate(index_type node);
+  index_type do_right_left_rotate(index_type node);
+  index_type do_right_right_rotate(index_type node);
+
+  template <typename F>
+  void do_for_each_in_range(index_type node, const key_type& lo,
+                            const key_type& hi, F& f) const;
+
+  void destroy_subtree(index_type node) noexcept;
+
+  template <typename EndT, typename F>
+  void do_overlapping(index_type node, const EndT& lo, const EndT& hi, F& f) const;
+
+  template <typename Iter>
+  index_type do_build(Iter& it, size_t n);
+
+  // Moves the nodes of `other` into our pool, returns its head
+  index_type adopt(AVLTree_Base& other, ThreadPool* tp);
+  void rebase(index_type node, index_type offset, ThreadPool* tp);
+  index_type move_subtree(AVLTree_Base& from, index_type node);
+
+  index_type do_insert_batch(index_type node, const value_type* first,
+                             const value_type* last, size_t& inserted);
+
+  // Tree of l, k, r, all keys in l < k < all keys in r
+  index_type do_join(index_type l, index_type k, index_type r);
+  index_type join_right(index_type l, index_type k, index_type r);
+  index_type join_left(index_type l, index_type k, index_type r);
+  // Same without a middle node
+  index_type do_join2(index_type l, index_type r);
+  // Detaches the last node of `node`, `rest` gets the remaining tree
+  index_type split_last(index_type node, index_type& rest);
+  // Splits `node` by `key` into l and r, returns the node with
+  // `key` (detached) or null_index
+  index_type do_split(index_type node, const key_type& key,
+                      index_type& l, index_type& r);
+
+  // Nodes dropped by the set operations; destroyed once all the
+  // (parallel) work is done since the pool is not thread safe
+  using Garbage = std::vector<index_type>;
+
+  index_type do_union(index_type a, index_type b, Garbage& g, ThreadPool* tp);
+  index_type do_intersection(index_type a, index_type b, Garbage& g, ThreadPool* tp);
+  index_type do_difference(index_type a, index_type b, Garbage& g, ThreadPool* tp);
+  void collect(index_type node, Garbage& g) const;
+  void release(const Garbage& g, size_t total_nodes);
+
+  template <typename F, typename G>
+  static void fork(ThreadPool* tp, uint32_t ht, Garbage& g, F&& f, G&& h);
 
 private:
-  NodeTypePtr head_ = nullptr;
+  PoolType pool_;
+  index_type head_ = null_index;
+  size_t size_ = 0;
   Comparator compare_;
 };
 
 
 
+template <typename KeyT, typename ValueT,
+	  typename Comparator = std::less<KeyT>>
+using OrderStatisticTree = AVLTree_Base<KeyT, ValueT, Comparator, avl_subtree_size>;
+
+// Map from half open intervals [lo, hi) to ValueT. overlapping()
+// is O(log n + k log(n/k)) for k hits in the worst case
+template <typename EndT, typename ValueT>
+using IntervalTree = AVLTree_Base<std::pair<EndT, EndT>, ValueT,
+                                  std::less<std::pair<EndT, EndT>>, avl_interval_max>;
+
 }// end namespace ds
 
 #endif
@@ -0,0 +1,396 @@
+// Build: g++ -std=c++14 -O2 -march=native -DNDEBUG -pthread bench.cpp -o bench
+// Usage: ./bench [num_keys]
+#include "avl_tree.hpp"
+#include "avl_tree.cpp"
+#include "frozen_avl_tree.cpp"
+#include "btree_map.hpp"
+#include "btree_map.cpp"
+#include "concurrent_avl_tree.hpp"
+#include "concurrent_avl_tree.cpp"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ds;
+
+namespace {
+
+template <typename F>
+double time_ns(F&& f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+void report(const char* name, const char* op, double ns, size_t ops, long check)
+{
+  std::cout << name << "\t" << op << "\t"
+            << ns / ops << " ns/op\t(check " << check << ")" << std::endl;
+}
+
+const int scan_len = 100;
+
+// AVLTree_Base and BTreeMap share insert/find/for_each_in_range
+template <typename Map>
+void bench_map(const char* name, const std::vector<int>& keys,
+               const std::vector<int>& probes)
+{
+  Map map;
+  long check = 0;
+  double ns = time_ns([&] {
+    for (auto k : keys) check += map.insert(std::make_pair(k, k));
+  });
+  report(name, "insert", ns, keys.size(), check);
+
+  check = 0;
+  ns = time_ns([&] {
+    for (auto k : probes) {
+      auto v = map.find(k);
+      if (v) check += *v;
+    }
+  });
+  report(name, "find", ns, probes.size(), check);
+
+  check = 0;
+  ns = time_ns([&] {
+    for (size_t i = 0; i < probes.size() / scan_len; i++) {
+      auto lo = probes[i];
+      map.for_each_in_range(lo, lo + scan_len,
+                            [&check](int, int v) { check += v; });
+    }
+  });
+  report(name, "scan", ns, probes.size() / scan_len, check);
+}
+
+// Lookups and scans of AVLTree_Base::freeze()
+void bench_frozen(const std::vector<int>& keys, const std::vector<int>& probes)
+{
+  const char* name = "FrozenAVLTree";
+  AVLTree_Base<int, int> tree;
+  for (auto k : keys) tree.insert(std::make_pair(k, k));
+
+  FrozenAVLTree<int, int> frozen;
+  double ns = time_ns([&] { frozen = tree.freeze(); });
+  report(name, "freeze", ns, keys.size(), frozen.size());
+
+  long check = 0;
+  ns = time_ns([&] {
+    for (auto k : probes) {
+      auto v = frozen.find(k);
+      if (v) check += *v;
+    }
+  });
+  report(name, "find", ns, probes.size(), check);
+
+  check = 0;
+  ns = time_ns([&] {
+    for (size_t i = 0; i < probes.size() / scan_len; i++) {
+      auto lo = probes[i];
+      frozen.for_each_in_range(lo, lo + scan_len,
+                               [&check](int, int v) { check += v; });
+    }
+  });
+  report(name, "scan", ns, probes.size() / scan_len, check);
+}
+
+void bench_std_map(const std::vector<int>& keys, const std::vector<int>& probes)
+{
+  const char* name = "std::map";
+  std::map<int, int> map;
+  long check = 0;
+  double ns = time_ns([&] {
+    for (auto k : keys) check += map.emplace(k, k).second;
+  });
+  report(name, "insert", ns, keys.size(), check);
+
+  check = 0;
+  ns = time_ns([&] {
+    for (auto k : probes) {
+      auto it = map.find(k);
+      if (it != map.end()) check += it->second;
+    }
+  });
+  report(name, "find", ns, probes.size(), check);
+
+  check = 0;
+  ns = time_ns([&] {
+    for (size_t i = 0; i < probes.size() / scan_len; i++) {
+      auto lo = probes[i];
+      auto last = map.lower_bound(lo + scan_len);
+      for (auto it = map.lower_bound(lo); it != last; ++it) check += it->second;
+    }
+  });
+  report(name, "scan", ns, probes.size() / scan_len, check);
+}
+
+// Keys 0..n-1 in an order that stresses the rebalancing
+std::vector<int> make_order(const std::string& order, size_t n, std::mt19937& gen)
+{
+  std::vector<int> keys(n);
+  std::iota(keys.begin(), keys.end(), 0);
+  if (order == "reverse") {
+    std::reverse(keys.begin(), keys.end());
+  } else if (order == "zigzag") {
+    // 0, n-1, 1, n-2, ... keeps both spines growing
+    for (size_t i = 0; i < n; i++) {
+      keys[i] = (i % 2) ? n - 1 - i / 2 : i / 2;
+    }
+  } else if (order == "random") {
+    std::shuffle(keys.begin(), keys.end(), gen);
+  }
+  return keys;
+}
+
+// Per operation cost of AVLTree_Base for growing n; with O(log n)
+// rebalancing the last column stays flat.
+void bench_insert_scaling(std::mt19937& gen)
+{
+  std::cout << "\norder\tn\tinsert ns/op\terase ns/op\tinsert ns/op/log2(n)"
+            << std::endl;
+  for (auto order : {"sorted", "reverse", "zigzag", "random"}) {
+    for (size_t n = 1 << 12; n <= (1 << 22); n <<= 2) {
+      auto keys = make_order(order, n, gen);
+      AVLTree_Base<int, int> map;
+      double ins = time_ns([&] {
+        for (auto k : keys) map.insert(std::make_pair(k, k));
+      });
+      double del = time_ns([&] {
+        for (auto k : keys) map.erase(k);
+      });
+      std::cout << order << "\t" << n << "\t" << ins / n << "\t"
+                << del / n << "\t" << ins / n / std::log2(n) << std::endl;
+    }
+  }
+}
+
+// Two sorted key sets with ~50% overlap
+void make_sets(size_t n, std::mt19937& gen, std::vector<std::pair<int, int>>& a,
+               std::vector<std::pair<int, int>>& b)
+{
+  a.clear();
+  b.clear();
+  for (size_t i = 0; i < 2 * n; i++) {
+    auto r = gen() % 4;
+    if (r != 0) a.emplace_back(i, i);
+    if (r != 1) b.emplace_back(i, i);
+  }
+}
+
+// A batch of k new random keys into a tree of n keys, one insert
+// per key against insert_batch
+void bench_insert_batch(size_t n, std::mt19937& gen)
+{
+  std::vector<std::pair<int, int>> base;
+  for (size_t i = 0; i < n; i++) base.emplace_back(2 * i, i);
+
+  std::cout << "\nbatch into " << n << " keys\tinsert ns/key\tinsert_batch ns/key"
+            << std::endl;
+  std::uniform_int_distribution<int> dist(0, 2 * n);
+  for (size_t k : {1000, 10000, 100000, 1000000}) {
+    std::vector<std::pair<int, int>> batch(k);
+    for (auto& e : batch) e.first = e.second = dist(gen) | 1;
+
+    AVLTree_Base<int, int> a, b;
+    a.build_from_sorted(base.begin(), base.end());
+    b.build_from_sorted(base.begin(), base.end());
+    double ns_single = time_ns([&] {
+      for (auto& e : batch) a.insert(e);
+    });
+    double ns_batch = time_ns([&] { b.insert_batch(batch.begin(), batch.end()); });
+    std::cout << k << "\t" << ns_single / k << "\t" << ns_batch / k
+              << "\t(check " << a.size() - b.size() << ")" << std::endl;
+  }
+}
+
+void bench_bulk_and_set_ops(size_t n, std::mt19937& gen)
+{
+  std::vector<std::pair<int, int>> a, b;
+  make_sets(n, gen, a, b);
+
+  AVLTree_Base<int, int> tree;
+  double ns = time_ns([&] {
+    for (auto& e : a) tree.insert(e);
+  });
+  std::cout << "\nbuild " << a.size() << " keys: insert " << ns / 1e6 << " ms";
+  ns = time_ns([&] { tree.build_from_sorted(a.begin(), a.end()); });
+  std::cout << ", build_from_sorted " << ns / 1e6 << " ms" << std::endl;
+
+  std::cout << "threads\tunion ms\tintersection ms\tdifference ms" << std::endl;
+  size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t nt = 1; nt <= max_threads; nt *= 2) {
+    ThreadPool tp(nt);
+    std::cout << nt;
+    for (int op = 0; op < 3; op++) {
+      AVLTree_Base<int, int> ta, tb;
+      ta.build_from_sorted(a.begin(), a.end());
+      tb.build_from_sorted(b.begin(), b.end());
+      ns = time_ns([&] {
+        if (op == 0) ta.set_union(tb, &tp);
+        else if (op == 1) ta.set_intersection(tb, &tp);
+        else ta.set_difference(tb, &tp);
+      });
+      std::cout << "\t" << ns / 1e6;
+    }
+    std::cout << std::endl;
+    if (nt < max_threads && nt * 2 > max_threads) nt = max_threads / 2;
+  }
+}
+
+// std::map behind a single mutex, the baseline for ConcurrentAVLTree
+class LockedStdMap
+{
+public:
+  bool find(int key, int& value) const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    auto it = map_.find(key);
+    if (it == map_.end()) return false;
+    value = it->second;
+    return true;
+  }
+  bool insert(const std::pair<int, int>& value) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return map_.insert(value).second;
+  }
+  bool erase(int key) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return map_.erase(key) == 1;
+  }
+
+private:
+  mutable std::mutex mutex_;
+  std::map<int, int> map_;
+};
+
+// Million operations per second of `nthreads` threads doing a mix
+// of read_pct% finds and evenly split inserts/erases over [0, range)
+template <typename Map>
+double run_mix(Map& map, size_t nthreads, size_t ops, int read_pct, int range)
+{
+  std::atomic<long> check{0};
+  double ns = time_ns([&] {
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nthreads; t++) {
+      threads.emplace_back([&, t] {
+        uint64_t x = 88172645463325252ull + t * 7919;
+        long local = 0;
+        int v;
+        for (size_t i = 0; i < ops / nthreads; i++) {
+          x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+          int key = static_cast<int>((x >> 16) % range);
+          int dice = static_cast<int>(x % 100);
+          if (dice < read_pct) local += map.find(key, v);
+          else if ((dice - read_pct) % 2 == 0) local += map.insert(std::make_pair(key, key));
+          else local += map.erase(key);
+        }
+        check += local;
+      });
+    }
+    for (auto& th : threads) th.join();
+  });
+  return ops / (ns / 1e3);
+}
+
+// Stabbing queries on IntervalTree against scanning every interval
+void bench_interval(size_t n, std::mt19937& gen)
+{
+  std::uniform_int_distribution<int> start(0, static_cast<int>(n));
+  std::uniform_int_distribution<int> len(1, 100);
+  IntervalTree<int, int> tree;
+  std::vector<std::pair<int, int>> all;
+  while (tree.size() < n) {
+    int s = start(gen);
+    auto iv = std::make_pair(s, s + len(gen));
+    if (tree.insert(std::make_pair(iv, s))) all.push_back(iv);
+  }
+
+  const size_t queries = 10000;
+  std::vector<int> points(queries);
+  for (auto& p : points) p = start(gen);
+
+  long check = 0;
+  double ns = time_ns([&] {
+    for (auto p : points) {
+      tree.overlapping(p, p + 1, [&check](const std::pair<int, int>&, int) { check++; });
+    }
+  });
+  std::cout << std::endl;
+  report("IntervalTree", "stab", ns, queries, check);
+
+  check = 0;
+  ns = time_ns([&] {
+    for (size_t q = 0; q < queries / 100; q++) {
+      for (auto& iv : all) check += iv.first <= points[q] && points[q] < iv.second;
+    }
+  });
+  report("linear scan", "stab", ns, queries / 100, check);
+}
+
+void bench_concurrent(size_t n)
+{
+  const int range = static_cast<int>(n);
+  const size_t ops = 2 * n;
+  std::cout << "\nconcurrent maps, " << range << " key range, Mops/s" << std::endl;
+  std::cout << "threads\tfind%\tConcurrentAVLTree\tstd::map+mutex" << std::endl;
+
+  size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+  for (int read_pct : {100, 90, 50}) {
+    for (size_t nt = 1; nt <= max_threads; nt *= 2) {
+      ConcurrentAVLTree<int, int> cmap;
+      LockedStdMap lmap;
+      // Half full, which the insert/erase mix keeps steady
+      for (int k = 0; k < range; k += 2) {
+        cmap.insert(std::make_pair(k, k));
+        lmap.insert(std::make_pair(k, k));
+      }
+      std::cout << nt << "\t" << read_pct
+                << "\t" << run_mix(cmap, nt, ops, read_pct, range)
+                << "\t" << run_mix(lmap, nt, ops, read_pct, range) << std::endl;
+      if (nt < max_threads && nt * 2 > max_threads) nt = max_threads / 2;
+    }
+  }
+}
+
+} // end anon namespace
+
+int main(int argc, char* argv[])
+{
+  size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+  std::mt19937 gen(1234);
+  std::vector<int> keys(n);
+  std::iota(keys.begin(), keys.end(), 0);
+  for (auto& k : keys) k *= 2;
+  std::shuffle(keys.begin(), keys.end(), gen);
+
+  // Half of the probes hit, half miss
+  std::uniform_int_distribution<int> dist(0, 2 * n);
+  std::vector<int> probes(n);
+  for (auto& p : probes) p = dist(gen);
+
+  std::cout << "keys: " << n << ", scan length: " << scan_len
+            << ", sizeof(AVLNode): " << sizeof(AVLTree_Base<int, int>::NodeType)
+            << std::endl;
+  bench_map<AVLTree_Base<int, int>>("AVLTree_Base", keys, probes);
+  bench_map<BTreeMap<int, int>>("BTreeMap", keys, probes);
+  bench_frozen(keys, probes);
+  bench_std_map(keys, probes);
+
+  bench_insert_scaling(gen);
+  bench_bulk_and_set_ops(n, gen);
+  bench_insert_batch(n, gen);
+  bench_interval(n, gen);
+  bench_concurrent(n);
+
+  return 0;
+}
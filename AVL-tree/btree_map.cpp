@@ -0,0 +1,218 @@
+#include "btree_map.hpp"
+using namespace ds;
+
+template <typename K, typename V, typename Comp>
+constexpr size_t BTreeMap<K, V, Comp>::node_slots;
+
+template <typename K, typename V, typename Comp>
+bool BTreeMap<K, V, Comp>::insert(const value_type& value)
+{
+  if (root_ == nullptr) {
+    auto leaf = new LeafNode();
+    leaf->keys_[0] = value.first;
+    leaf->values_[0] = value.second;
+    leaf->count_ = 1;
+    root_ = leaf;
+    size_ = 1;
+    return true;
+  }
+
+  K split_key;
+  NodeBase* split_node = nullptr;
+  if (!do_insert(root_, value, split_key, split_node)) {
+    return false;
+  }
+
+  if (split_node) {
+    // Root was split, grow the tree by one level
+    auto root = new InnerNode();
+    root->keys_[0] = split_key;
+    root->children_[0] = root_;
+    root->children_[1] = split_node;
+    root->count_ = 1;
+    root_ = root;
+  }
+  size_++;
+  return true;
+}
+
+template <typename K, typename V, typename Comp>
+bool BTreeMap<K, V, Comp>::
+do_insert(NodeBase* node, const value_type& value,
+          K& split_key, NodeBase*& split_node)
+{
+  assert (node);
+  if (node->leaf_) {
+    return leaf_insert(static_cast<LeafNode*>(node), value,
+                       split_key, split_node);
+  }
+
+  auto inner = static_cast<InnerNode*>(node);
+  auto pos = upper_bound(inner, value.first);
+
+  K child_key;
+  NodeBase* child_split = nullptr;
+  if (!do_insert(inner->children_[pos], value, child_key, child_split)) {
+    return false;
+  }
+  if (child_split) {
+    inner_insert(inner, pos, child_key, child_split, split_key, split_node);
+  }
+  return true;
+}
+
+template <typename K, typename V, typename Comp>
+bool BTreeMap<K, V, Comp>::
+leaf_insert(LeafNode* leaf, const value_type& value,
+            K& split_key, NodeBase*& split_node)
+{
+  auto pos = lower_bound(leaf, value.first);
+  if (pos < leaf->count_ && !compare_(value.first, leaf->keys_[pos])) {
+    return false;
+  }
+
+  LeafNode* target = leaf;
+  if (leaf->count_ == node_slots) {
+    // Move the upper half into a new right sibling
+    const size_t half = node_slots / 2;
+    auto right = new LeafNode();
+    std::move(leaf->keys_ + half, leaf->keys_ + node_slots, right->keys_);
+    std::move(leaf->values_ + half, leaf->values_ + node_slots, right->values_);
+    right->count_ = node_slots - half;
+    leaf->count_ = half;
+    right->next_ = leaf->next_;
+    leaf->next_ = right;
+
+    if (pos > half) {
+      target = right;
+      pos -= half;
+    }
+    split_node = right;
+  }
+
+  auto cnt = target->count_;
+  std::move_backward(target->keys_ + pos, target->keys_ + cnt,
+                     target->keys_ + cnt + 1);
+  std::move_backward(target->values_ + pos, target->values_ + cnt,
+                     target->values_ + cnt + 1);
+  target->keys_[pos] = value.first;
+  target->values_[pos] = value.second;
+  target->count_++;
+
+  if (split_node) split_key = static_cast<LeafNode*>(split_node)->keys_[0];
+  return true;
+}
+
+template <typename K, typename V, typename Comp>
+void BTreeMap<K, V, Comp>::
+inner_insert(InnerNode* node, size_t pos, const K& key, NodeBase* child,
+             K& split_key, NodeBase*& split_node)
+{
+  auto cnt = node->count_;
+  if (cnt < node_slots) {
+    std::move_backward(node->keys_ + pos, node->keys_ + cnt,
+                       node->keys_ + cnt + 1);
+    std::move_backward(node->children_ + pos + 1, node->children_ + cnt + 1,
+                       node->children_ + cnt + 2);
+    node->keys_[pos] = key;
+    node->children_[pos + 1] = child;
+    node->count_++;
+    return;
+  }
+
+  // Node is full: lay out the node_slots + 1 keys in scratch
+  // space and promote the middle one.
+  K keys[node_slots + 1];
+  NodeBase* children[node_slots + 2];
+
+  std::move(node->keys_, node->keys_ + pos, keys);
+  keys[pos] = key;
+  std::move(node->keys_ + pos, node->keys_ + cnt, keys + pos + 1);
+
+  std::copy(node->children_, node->children_ + pos + 1, children);
+  children[pos + 1] = child;
+  std::copy(node->children_ + pos + 1, node->children_ + cnt + 1,
+            children + pos + 2);
+
+  const size_t mid = (node_slots + 1) / 2;
+  auto right = new InnerNode();
+
+  std::move(keys, keys + mid, node->keys_);
+  std::copy(children, children + mid + 1, node->children_);
+  node->count_ = mid;
+
+  std::move(keys + mid + 1, keys + node_slots + 1, right->keys_);
+  std::copy(children + mid + 1, children + node_slots + 2, right->children_);
+  right->count_ = node_slots - mid;
+
+  split_key = keys[mid];
+  split_node = right;
+}
+
+template <typename K, typename V, typename Comp>
+auto BTreeMap<K, V, Comp>::find_leaf(const K& key) const
+  -> const LeafNode*
+{
+  const NodeBase* node = root_;
+  if (!node) return nullptr;
+
+  while (!node->leaf_) {
+    auto inner = static_cast<const InnerNode*>(node);
+    node = inner->children_[upper_bound(inner, key)];
+  }
+  return static_cast<const LeafNode*>(node);
+}
+
+template <typename K, typename V, typename Comp>
+const V* BTreeMap<K, V, Comp>::find(const K& key) const
+{
+  auto leaf = find_leaf(key);
+  if (!leaf) return nullptr;
+
+  auto pos = lower_bound(leaf, key);
+  if (pos < leaf->count_ && !compare_(key, leaf->keys_[pos])) {
+    return &leaf->values_[pos];
+  }
+  return nullptr;
+}
+
+template <typename K, typename V, typename Comp>
+template <typename F>
+void BTreeMap<K, V, Comp>::
+for_each_in_range(const K& lo, const K& hi, F&& f) const
+{
+  auto leaf = find_leaf(lo);
+  if (!leaf) return;
+
+  size_t pos = lower_bound(leaf, lo);
+  while (leaf) {
+    for (; pos < leaf->count_; pos++) {
+      if (!compare_(leaf->keys_[pos], hi)) return;
+      f(leaf->keys_[pos], leaf->values_[pos]);
+    }
+    leaf = leaf->next_;
+    pos = 0;
+  }
+}
+
+template <typename K, typename V, typename Comp>
+void BTreeMap<K, V, Comp>::clear()
+{
+  if (root_) destroy(root_);
+  root_ = nullptr;
+  size_ = 0;
+}
+
+template <typename K, typename V, typename Comp>
+void BTreeMap<K, V, Comp>::destroy(NodeBase* node)
+{
+  if (node->leaf_) {
+    delete static_cast<LeafNode*>(node);
+    return;
+  }
+  auto inner = static_cast<InnerNode*>(node);
+  for (size_t i = 0; i <= inner->count_; i++) {
+    destroy(inner->children_[i]);
+  }
+  delete inner;
+}
@@ -0,0 +1,209 @@
+#ifndef BTREE_MAP_HPP
+#define BTREE_MAP_HPP
+/*!
+ * Cache conscious ordered map.
+ * A B+-tree whose nodes hold many sorted keys sized to a few
+ * cache lines. A lookup touches O(log_B n) nodes instead of the
+ * O(log2 n) AVLNode's chased by AVLTree_Base.
+ * Keys of a node are kept in their own contiguous array so that
+ * a node search only touches key cache lines; for 32/64 bit
+ * integer keys ordered by std::less the search is done with SSE.
+ *
+ * Requirements: KeyT and ValueT must be default constructible
+ * and copy assignable (slots of a node are plain arrays).
+ */
+
+#if __cplusplus < 201103L
+  #error This header needs atleast a C++11 compliant compiler.
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+#if defined(__SSE4_2__)
+  #include <nmmintrin.h>
+#endif
+
+namespace ds {
+
+namespace detail {
+
+constexpr size_t btree_cache_line = 64;
+// Number of cache lines spanned by the key array of a node
+constexpr size_t btree_key_lines = 4;
+
+template <typename KeyT>
+constexpr size_t btree_slots() {
+  return (btree_cache_line * btree_key_lines / sizeof(KeyT)) < 8 ?
+    8 : (btree_cache_line * btree_key_lines / sizeof(KeyT));
+}
+
+/*
+ * Returns the index of the first key in [keys, keys + count)
+ * which is not less than `key`. Same as std::lower_bound
+ * restricted to a single node.
+ */
+template <typename KeyT, typename Comparator>
+struct btree_node_search
+{
+  static size_t lower_bound(const KeyT* keys, size_t count,
+                            const KeyT& key, const Comparator& cmp)
+  {
+    return std::lower_bound(keys, keys + count, key, cmp) - keys;
+  }
+};
+
+#if defined(__SSE2__)
+// Keys are sorted, so the mask of "keys[i] < key" is a run of
+// ones and its popcount is the lower bound inside the block.
+template <>
+struct btree_node_search<int32_t, std::less<int32_t>>
+{
+  static size_t lower_bound(const int32_t* keys, size_t count,
+                            int32_t key, const std::less<int32_t>&)
+  {
+    const __m128i needle = _mm_set1_epi32(key);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      __m128i blk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+      int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(blk, needle)));
+      if (mask != 0xF) return i + __builtin_popcount(mask);
+    }
+    while (i < count && keys[i] < key) i++;
+    return i;
+  }
+};
+#endif
+
+#if defined(__SSE4_2__)
+template <>
+struct btree_node_search<int64_t, std::less<int64_t>>
+{
+  static size_t lower_bound(const int64_t* keys, size_t count,
+                            int64_t key, const std::less<int64_t>&)
+  {
+    const __m128i needle = _mm_set1_epi64x(key);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+      __m128i blk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+      int mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(needle, blk)));
+      if (mask != 0x3) return i + __builtin_popcount(mask);
+    }
+    while (i < count && keys[i] < key) i++;
+    return i;
+  }
+};
+#endif
+
+} // END namespace detail
+
+/*
+ * @class BTreeMap
+ * Ordered map with the same key/value/Comparator shape
+ * as AVLTree_Base.
+ * Inner nodes route lookups, all key-value pairs live in the
+ * leaves which are chained left to right for range scans.
+ *
+ * Exposed API's:
+ * 1. insert() - Returns false if the key is already present.
+ * 2. find()   - Returns nullptr if the key is not present.
+ * 3. for_each_in_range(lo, hi, f) - Calls f(key, value) for
+ *    every key in [lo, hi) in ascending order.
+ */
+template <typename KeyT, typename ValueT,
+	  typename Comparator = std::less<KeyT>>
+class BTreeMap
+{
+public:
+  using key_type = KeyT;
+  using mapped_type = ValueT;
+  using value_type = std::pair<KeyT, ValueT>;
+
+  static constexpr size_t node_slots = detail::btree_slots<KeyT>();
+
+public:
+  BTreeMap() = default;
+  BTreeMap(const BTreeMap&) = delete;
+  void operator=(const BTreeMap&) = delete;
+  ~BTreeMap() { clear(); }
+
+public:
+  bool insert(const value_type& value);
+
+  const ValueT* find(const KeyT& key) const;
+
+  ValueT* find(const KeyT& key) {
+    return const_cast<ValueT*>(
+        static_cast<const BTreeMap*>(this)->find(key));
+  }
+
+  template <typename F>
+  void for_each_in_range(const KeyT& lo, const KeyT& hi, F&& f) const;
+
+  void clear();
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+private:
+  struct NodeBase {
+    NodeBase(bool leaf): leaf_(leaf) {}
+    uint32_t count_ = 0;
+    bool leaf_;
+    KeyT keys_[node_slots];
+  };
+
+  // keys_[i] is the smallest key reachable through children_[i + 1]
+  struct InnerNode: NodeBase {
+    InnerNode(): NodeBase(false) {}
+    NodeBase* children_[node_slots + 1];
+  };
+
+  struct LeafNode: NodeBase {
+    LeafNode(): NodeBase(true) {}
+    ValueT values_[node_slots];
+    LeafNode* next_ = nullptr;
+  };
+
+private:
+  size_t lower_bound(const NodeBase* node, const KeyT& key) const {
+    return detail::btree_node_search<KeyT, Comparator>::lower_bound(
+        node->keys_, node->count_, key, compare_);
+  }
+
+  size_t upper_bound(const NodeBase* node, const KeyT& key) const {
+    auto pos = lower_bound(node, key);
+    if (pos < node->count_ && !compare_(key, node->keys_[pos])) pos++;
+    return pos;
+  }
+
+  const LeafNode* find_leaf(const KeyT& key) const;
+
+  bool do_insert(NodeBase* node, const value_type& value,
+                 KeyT& split_key, NodeBase*& split_node);
+
+  bool leaf_insert(LeafNode* leaf, const value_type& value,
+                   KeyT& split_key, NodeBase*& split_node);
+
+  void inner_insert(InnerNode* node, size_t pos,
+                    const KeyT& key, NodeBase* child,
+                    KeyT& split_key, NodeBase*& split_node);
+
+  void destroy(NodeBase* node);
+
+private:
+  NodeBase* root_ = nullptr;
+  size_t size_ = 0;
+  Comparator compare_;
+};
+
+}// end namespace ds
+
+#endif
@@ -0,0 +1,689 @@
+#include "concurrent_avl_tree.hpp"
+using namespace ds;
+
+template <typename K, typename V, typename Comp>
+ConcurrentAVLTree<K, V, Comp>::~ConcurrentAVLTree()
+{
+  destroy(root_holder_.child(false));
+  for (auto& slot : slots_) {
+    for (auto& r : slot.retired_) delete r.second;
+  }
+}
+
+template <typename K, typename V, typename Comp>
+void ConcurrentAVLTree<K, V, Comp>::destroy(Node* node)
+{
+  if (!node) return;
+  destroy(node->child(true));
+  destroy(node->child(false));
+  delete node;
+}
+
+//====== Epoch based reclamation
+
+template <typename K, typename V, typename Comp>
+void ConcurrentAVLTree<K, V, Comp>::retire(Node* node)
+{
+  EpochSlot* slot = current_slot();
+  assert (slot);
+  // Read after the unlink: no operation starting from now on sees node
+  slot->retired_.emplace_back(epoch_.load(), node);
+}
+
+template <typename K, typename V, typename Comp>
+typename ConcurrentAVLTree<K, V, Comp>::EpochSlot*
+ConcurrentAVLTree<K, V, Comp>::enter_epoch() const
+{
+  // Threads tend to get the same slot back, with its retire list
+  size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+  for (size_t i = 0;; i++) {
+    EpochSlot& slot = slots_[(start + i) % epoch_slots];
+    uint64_t e = epoch_.load();
+    uint64_t idle = 0;
+    if (slot.state_.load(std::memory_order_relaxed) == 0 &&
+        slot.state_.compare_exchange_strong(idle, e << 1 | 1)) {
+      // The epoch may have moved on before the announcement was
+      // visible, announce until they agree
+      for (uint64_t now; (now = epoch_.load()) != e;) {
+        e = now;
+        slot.state_.store(e << 1 | 1);
+      }
+      return &slot;
+    }
+    if (i % epoch_slots == epoch_slots - 1) std::this_thread::yield();
+  }
+}
+
+template <typename K, typename V, typename Comp>
+void ConcurrentAVLTree<K, V, Comp>::leave_epoch(EpochSlot* slot) const
+{
+  if (slot->retired_.size() >= reclaim_batch) {
+    bool advanced = try_advance_epoch();
+    reclaim(*slot);
+    // Lists of slots no thread comes back to would never shrink
+    // otherwise: claim the idle ones and reclaim them too
+    if (advanced) {
+      for (auto& other : slots_) {
+        uint64_t idle = 0;
+        if (&other == slot || other.state_.load(std::memory_order_relaxed) != 0 ||
+            !other.state_.compare_exchange_strong(idle, epoch_.load() << 1 | 1)) {
+          continue;
+        }
+        reclaim(other);
+        other.state_.store(0, std::memory_order_release);
+      }
+    }
+  }
+  slot->state_.store(0, std::memory_order_release);
+}
+
+// Deletes the nodes of the held slot unlinked two epochs ago or earlier
+template <typename K, typename V, typename Comp>
+void ConcurrentAVLTree<K, V, Comp>::reclaim(EpochSlot& slot) const
+{
+  auto& retired = slot.retired_;
+  uint64_t e = epoch_.load();
+  // Tags never decrease along the list
+  auto end = retired.begin();
+  while (end != retired.end() && end->first + 2 <= e) delete (end++)->second;
+  retired.erase(retired.begin(), end);
+}
+
+template <typename K, typename V, typename Comp>
+bool ConcurrentAVLTree<K, V, Comp>::try_advance_epoch() const
+{
+  uint64_t e = epoch_.load();
+  for (auto& slot : slots_) {
+    uint64_t state = slot.state_.load();
+    if (state != 0 && (state >> 1) != e) return false;
+  }
+  return epoch_.compare_exchange_strong(e, e + 1);
+}
+
+//====== Optimistic value access
+
+template <typename K, typename V, typename Comp>
+bool ConcurrentAVLTree<K, V, Comp>::read_value(const Node* node, V* value)
+{
+  while (true) {
+    auto seq = node->vseq_.load(std::memory_order_acquire);
+    if (seq & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    // Acquire keeps the second sequence read after the data reads
+    bool present = node->present_.load(std::memory_order_acquire);
+    V v = node->value_.load(std::memory_order_acquire);
+    if (node->vseq_.load(std::memory_order_relaxed) != seq) continue;
+
+    if (present && value) *value = v;
+    return present;
+  }
+}
+
+template <typename K, typename V, typename Comp>
+void ConcurrentAVLTree<K, V, Comp>::write_value(Node* node, bool present, const V* value)
+{
+  auto seq = node->vseq_.load(std::memory_order_relaxed);
+  node->vseq_.store(seq + 1, std::memory_order_relaxed);
+  // Release keeps the odd sequence store ahead of the data stores
+  node->present_.store(present, std::memory_order_release);
+  if (value) node->value_.store(*value, std::memory_order_release);
+  node->vseq_.store(seq + 2, std::memory_order_release);
+}
+
+template <typename K, typename V, typename Comp>
+void ConcurrentAVLTree<K, V, Comp>::wait_until_shrink_completed(
+    const Node* node, uint64_t version)
+{
+  if (!(version & shrinking)) return;
+  // A rotation holds the version for a handful of stores only
+  for (int i = 0; i < 100; i++) {
+    if (node->version_.load() != version) return;
+  }
+  while (node->version_.load() == version) std::this_thread::yield();
+}
+
+//====== Lookup
+
+template <typename K, typename V, typename Comp>
+bool ConcurrentAVLTree<K, V, Comp>::find(const K& key, V& value) const
+{
+  EpochGuard guard(*this);
+  while (true) {
+    const Node* right = root_holder_.child(false);
+    if (!right) return false;
+
+    int cmp = compare(key, right);
+    if (cmp == 0) return read_value(right, &value);
+
+    uint64_t version = right->version_.load();
+    if (is_shrinking_or_unlinked(version)) {
+      wait_until_shrink_completed(right, version);
+    } else if (right == root_holder_.child(false)) {
+      auto res = attempt_get(key, right, cmp < 0, version, value);
+      if (res != Attempt::Retry) return res == Attempt::Found;
+    }
+  }
+}
+
+/*
+ * Searches the subtree of `node` in direction `dir_left`.
+ * `node_version` is the version under which the caller found
+ * `node`; if it changes, the subtree may no longer cover `key`
+ * and the caller must retry from one level up.
+ */
+template <typename K, typename V, typename Comp>
+typename ConcurrentAVLTree<K, V, Comp>::Attempt
+ConcurrentAVLTree<K, V, Comp>::attempt_get(const K& key, const Node* node,
+                                           bool dir_left, uint64_t node_version,
+                                           V& value) const
+{
+  while (true) {
+    const Node* child = node->child(dir_left);
+    if (!child) {
+      if (node->version_.load() != node_version) return Attempt::Retry;
+      return Attempt::NotFound;
+    }
+
+    int cmp = compare(key, child);
+    if (cmp == 0) {
+      return read_value(child, &value) ? Attempt::Found : Attempt::NotFound;
+    }
+
+    uint64_t child_version = child->version_.load();
+    if (is_shrinking_or_unlinked(child_version)) {
+      wait_until_shrink_completed(child, child_version);
+      if (node->version_.load() != node_version) return Attempt::Retry;
+    } else if (child != node->child(dir_left)) {
+      if (node->version_.load() != node_version) return Attempt::Retry;
+    } else {
+      // The step into child is valid, child_version protects the rest
+      if (node->version_.load() != node_version) return Attempt::Retry;
+      auto res = attempt_get(key, child, cmp < 0, child_version, value);
+      if (res != Attempt::Retry) return res;
+    }
+  }
+}
+
+//====== Update
+
+template <typename K, typename V, typename Comp>
+bool ConcurrentAVLTree<K, V, Comp>::update(const K& key, UpdateMode mode,
+                                           const V* value)
+{
+  EpochGuard guard(*this);
+  while (true) {
+    Attempt res = Attempt::Retry;
+    Node* right = root_holder_.child(false);
+
+    if (!right) {
+      if (mode == UpdateMode::Erase) return false;
+      if (attempt_insert_into_empty(key, value)) res = Attempt::Updated;
+    } else {
+      uint64_t version = right->version_.load();
+      if (is_shrinking_or_unlinked(version)) {
+        wait_until_shrink_completed(right, version);
+      } else if (right == root_holder_.child(false)) {
+        res = attempt_update(key, mode, value, &root_holder_, right, version);
+      }
+    }
+
+    if (res == Attempt::Retry) continue;
+    if (res == Attempt::Updated) size_ += (mode == UpdateMode::Erase) ? -1 : 1;
+    return res == Attempt::Updated;
+  }
+}
+
+template <typename K, typename V, typename Comp>
+bool ConcurrentAVLTree<K, V, Comp>::attempt_insert_into_empty(const K& key,
+                                                              const V* value)
+{
+  LockGuard lk(root_holder_.lock_);
+  if (root_holder_.child(false)) return false;
+  root_holder_.child(false, new Node(key, *value, &root_holder_));
+  root_holder_.height_.store(2);
+  return true;
+}
+
+/*
+ * Returns Updated if a key was inserted or erased, Found if the
+ * value of an existing key was assigned, Unchanged if there was
+ * nothing to do and Retry if `node_version` got invalidated.
+ */
+template <typename K, typename V, typename Comp>
+typename ConcurrentAVLTree<K, V, Comp>::Attempt
+ConcurrentAVLTree<K, V, Comp>::attempt_update(const K& key, UpdateMode mode,
+                                              const V* value, Node* parent,
+                                              Node* node, uint64_t node_version)
+{
+  int cmp = compare(key, node);
+  if (cmp == 0) return attempt_node_update(mode, value, parent, node);
+  bool dir_left = cmp < 0;
+
+  while (true) {
+    Node* child = node->child(dir_left);
+    if (node->version_.load() != node_version) return Attempt::Retry;
+
+    if (!child) {
+      if (mode == UpdateMode::Erase) return Attempt::Unchanged;
+
+      Node* damaged = nullptr;
+      {
+        LockGuard lk(node->lock_);
+        // With the lock held no rotation can move node any more
+        if (node->version_.load() != node_version) return Attempt::Retry;
+        // Else lost a race with a concurrent insert, retry locally
+        if (node->child(dir_left)) continue;
+
+        node->child(dir_left, new Node(key, *value, node));
+        damaged = fix_height_nl(node);
+      }
+      fix_height_and_rebalance(damaged);
+      return Attempt::Updated;
+    }
+
+    uint64_t child_version = child->version_.load();
+    if (is_shrinking_or_unlinked(child_version)) {
+      wait_until_shrink_completed(child, child_version);
+    } else if (child != node->child(dir_left)) {
+      // Retry, the second read is protected by child_version
+    } else {
+      if (node->version_.load() != node_version) return Attempt::Retry;
+      auto res = attempt_update(key, mode, value, node, child, child_version);
+      if (res != Attempt::Retry) return res;
+    }
+  }
+}
+
+// `parent` is only needed to unlink node and may be stale otherwise
+template <typename K, typename V, typename Comp>
+typename ConcurrentAVLTree<K, V, Comp>::Attempt
+ConcurrentAVLTree<K, V, Comp>::attempt_node_update(UpdateMode mode, const V* value,
+                                                   Node* parent, Node* node)
+{
+  if (mode == UpdateMode::Erase) {
+    if (!node->present_.load()) return Attempt::Unchanged;
+
+    if (!node->child(true) || !node->child(false)) {
+      // Unlink, which needs the parent lock as well
+      Node* damaged = nullptr;
+      {
+        LockGuard plk(parent->lock_);
+        if (is_unlinked(parent->version_.load()) ||
+            node->parent_.load() != parent) {
+          return Attempt::Retry;
+        }
+        {
+          LockGuard lk(node->lock_);
+          if (!node->present_.load()) return Attempt::Unchanged;
+          if (!attempt_unlink_nl(parent, node)) return Attempt::Retry;
+        }
+        damaged = fix_height_nl(parent);
+      }
+      fix_height_and_rebalance(damaged);
+      return Attempt::Updated;
+    }
+  }
+
+  LockGuard lk(node->lock_);
+  if (is_unlinked(node->version_.load())) return Attempt::Retry;
+  bool present = node->present_.load();
+
+  if (mode == UpdateMode::Erase) {
+    if (!present) return Attempt::Unchanged;
+    // A child went away meanwhile, unlinking is possible again
+    if (!node->child(true) || !node->child(false)) return Attempt::Retry;
+    // Keep node around for routing
+    write_value(node, false, nullptr);
+    return Attempt::Updated;
+  }
+
+  if (present && mode == UpdateMode::Insert) return Attempt::Unchanged;
+  write_value(node, true, value);
+  return present ? Attempt::Found : Attempt::Updated;
+}
+
+// Both parent and node must be locked
+template <typename K, typename V, typename Comp>
+bool ConcurrentAVLTree<K, V, Comp>::attempt_unlink_nl(Node* parent, Node* node)
+{
+  Node* parent_l = parent->child(true);
+  Node* parent_r = parent->child(false);
+  if (parent_l != node && parent_r != node) return false;
+
+  Node* left = node->child(true);
+  Node* right = node->child(false);
+  if (left && right) return false;
+
+  Node* splice = left ? left : right;
+  parent->child(parent_l == node, splice);
+  if (splice) splice->parent_.store(parent);
+
+  node->version_.store(unlinked);
+  write_value(node, false, nullptr);
+  retire(node);
+  return true;
+}
+
+//====== Relaxed rebalancing
+
+template <typename K, typename V, typename Comp>
+int ConcurrentAVLTree<K, V, Comp>::node_condition(Node* node)
+{
+  // The reads are not atomic as a whole, so the answer is only a hint
+  Node* left = node->child(true);
+  Node* right = node->child(false);
+  if ((!left || !right) && !node->present_.load()) return unlink_required;
+
+  int hn = node->height_.load();
+  int hl = height(left);
+  int hr = height(right);
+  int hn_repl = 1 + std::max(hl, hr);
+  int bal = hl - hr;
+
+  if (bal < -1 || bal > 1) return rebalance_required;
+  return hn != hn_repl ? hn_repl : nothing_required;
+}
+
+template <typename K, typename V, typename Comp>
+void ConcurrentAVLTree<K, V, Comp>::fix_height_and_rebalance(Node* node)
+{
+  // Stops at the root holder which has no parent
+  while (node && node->parent_.load()) {
+    int cond = node_condition(node);
+    if (cond == nothing_required || is_unlinked(node->version_.load())) return;
+
+    if (cond != unlink_required && cond != rebalance_required) {
+      LockGuard lk(node->lock_);
+      node = fix_height_nl(node);
+    } else {
+      Node* parent = node->parent_.load();
+      LockGuard plk(parent->lock_);
+      if (!is_unlinked(parent->version_.load()) && node->parent_.load() == parent) {
+        LockGuard lk(node->lock_);
+        node = rebalance_nl(parent, node);
+      }
+    }
+  }
+}
+
+/*
+ * Fixes the height of the locked node. Returns the node that is
+ * still damaged and this thread is responsible for, or nullptr.
+ */
+template <typename K, typename V, typename Comp>
+typename ConcurrentAVLTree<K, V, Comp>::Node*
+ConcurrentAVLTree<K, V, Comp>::fix_height_nl(Node* node)
+{
+  int cond = node_condition(node);
+  switch (cond) {
+  case rebalance_required:
+  case unlink_required:
+    return node;
+  case nothing_required:
+    return nullptr;
+  default:
+    node->height_.store(cond);
+    // Damages the parent, which is not locked
+    return node->parent_.load();
+  }
+}
+
+// parent and node must be locked
+template <typename K, typename V, typename Comp>
+typename ConcurrentAVLTree<K, V, Comp>::Node*
+ConcurrentAVLTree<K, V, Comp>::rebalance_nl(Node* parent, Node* node)
+{
+  Node* left = node->child(true);
+  Node* right = node->child(false);
+  if ((!left || !right) && !node->present_.load()) {
+    if (attempt_unlink_nl(parent, node)) return fix_height_nl(parent);
+    return node;
+  }
+
+  int hn = node->height_.load();
+  int hl0 = height(left);
+  int hr0 = height(right);
+  int hn_repl = 1 + std::max(hl0, hr0);
+  int bal = hl0 - hr0;
+
+  if (bal > 1) return rebalance_to_right_nl(parent, node, left, hr0);
+  if (bal < -1) return rebalance_to_left_nl(parent, node, right, hl0);
+  if (hn_repl != hn) {
+    node->height_.store(hn_repl);
+    return fix_height_nl(parent);
+  }
+  return nullptr;
+}
+
+template <typename K, typename V, typename Comp>
+typename ConcurrentAVLTree<K, V, Comp>::Node*
+ConcurrentAVLTree<K, V, Comp>::rebalance_to_right_nl(Node* parent, Node* node,
+                                                     Node* left, int hr0)
+{
+  LockGuard llk(left->lock_);
+  int hl = left->height_.load();
+  if (hl - hr0 <= 1) return node;
+
+  Node* left_r = left->child(false);
+  int hll0 = height(left->child(true));
+  int hlr0 = height(left_r);
+  if (hll0 >= hlr0) {
+    return rotate_right_nl(parent, node, left, hr0, hll0, left_r, hlr0);
+  }
+  {
+    LockGuard lrlk(left_r->lock_);
+    int hlr = left_r->height_.load();
+    if (hll0 >= hlr) {
+      return rotate_right_nl(parent, node, left, hr0, hll0, left_r, hlr);
+    }
+    int hlrl = height(left_r->child(true));
+    int bal = hll0 - hlrl;
+    // Double rotate only if it leaves left undamaged
+    if (bal >= -1 && bal <= 1 &&
+        !((hll0 == 0 || hlrl == 0) && !left->present_.load())) {
+      return rotate_right_over_left_nl(parent, node, left, hr0, hll0, left_r, hlrl);
+    }
+  }
+  // Fix left first, node gets balanced later if needed
+  return rebalance_to_left_nl(node, left, left_r, hll0);
+}
+
+template <typename K, typename V, typename Comp>
+typename ConcurrentAVLTree<K, V, Comp>::Node*
+ConcurrentAVLTree<K, V, Comp>::rebalance_to_left_nl(Node* parent, Node* node,
+                                                    Node* right, int hl0)
+{
+  LockGuard rlk(right->lock_);
+  int hr = right->height_.load();
+  if (hl0 - hr >= -1) return node;
+
+  Node* right_l = right->child(true);
+  int hrl0 = height(right_l);
+  int hrr0 = height(right->child(false));
+  if (hrr0 >= hrl0) {
+    return rotate_left_nl(parent, node, hl0, right, right_l, hrl0, hrr0);
+  }
+  {
+    LockGuard rllk(right_l->lock_);
+    int hrl = right_l->height_.load();
+    if (hrr0 >= hrl) {
+      return rotate_left_nl(parent, node, hl0, right, right_l, hrl, hrr0);
+    }
+    int hrlr = height(right_l->child(false));
+    int bal = hrr0 - hrlr;
+    if (bal >= -1 && bal <= 1 &&
+        !((hrr0 == 0 || hrlr == 0) && !right->present_.load())) {
+      return rotate_left_over_right_nl(parent, node, hl0, right, right_l, hrr0, hrlr);
+    }
+  }
+  return rebalance_to_right_nl(node, right, right_l, hrr0);
+}
+
+/*
+ * The rotations below mark `node`, the one moving down, as
+ * shrinking so that readers which are about to step from node
+ * into the subtree that leaves it, retry.
+ * Each returns the deepest node still damaged, or nullptr.
+ */
+template <typename K, typename V, typename Comp>
+typename ConcurrentAVLTree<K, V, Comp>::Node*
+ConcurrentAVLTree<K, V, Comp>::rotate_right_nl(Node* parent, Node* node, Node* left,
+                                               int hr, int hll, Node* left_r, int hlr)
+{
+  uint64_t version = node->version_.load();
+  Node* parent_l = parent->child(true);
+
+  node->version_.store(begin_shrink(version));
+
+  node->child(true, left_r);
+  if (left_r) left_r->parent_.store(node);
+  left->child(false, node);
+  node->parent_.store(left);
+  parent->child(parent_l == node, left);
+  left->parent_.store(parent);
+
+  int hn_repl = 1 + std::max(hlr, hr);
+  node->height_.store(hn_repl);
+  left->height_.store(1 + std::max(hll, hn_repl));
+
+  node->version_.store(end_shrink(version));
+
+  int bal_n = hlr - hr;
+  if (bal_n < -1 || bal_n > 1) return node;
+  // node may have become a routing node with a single child
+  if ((!left_r || hr == 0) && !node->present_.load()) return node;
+
+  int bal_l = hll - hn_repl;
+  if (bal_l < -1 || bal_l > 1) return left;
+  if (hll == 0 && !left->present_.load()) return left;
+
+  return fix_height_nl(parent);
+}
+
+template <typename K, typename V, typename Comp>
+typename ConcurrentAVLTree<K, V, Comp>::Node*
+ConcurrentAVLTree<K, V, Comp>::rotate_left_nl(Node* parent, Node* node, int hl,
+                                              Node* right, Node* right_l, int hrl, int hrr)
+{
+  uint64_t version = node->version_.load();
+  Node* parent_l = parent->child(true);
+
+  node->version_.store(begin_shrink(version));
+
+  node->child(false, right_l);
+  if (right_l) right_l->parent_.store(node);
+  right->child(true, node);
+  node->parent_.store(right);
+  parent->child(parent_l == node, right);
+  right->parent_.store(parent);
+
+  int hn_repl = 1 + std::max(hl, hrl);
+  node->height_.store(hn_repl);
+  right->height_.store(1 + std::max(hn_repl, hrr));
+
+  node->version_.store(end_shrink(version));
+
+  int bal_n = hrl - hl;
+  if (bal_n < -1 || bal_n > 1) return node;
+  if ((!right_l || hl == 0) && !node->present_.load()) return node;
+
+  int bal_r = hrr - hn_repl;
+  if (bal_r < -1 || bal_r > 1) return right;
+  if (hrr == 0 && !right->present_.load()) return right;
+
+  return fix_height_nl(parent);
+}
+
+template <typename K, typename V, typename Comp>
+typename ConcurrentAVLTree<K, V, Comp>::Node*
+ConcurrentAVLTree<K, V, Comp>::rotate_right_over_left_nl(Node* parent, Node* node,
+                                                         Node* left, int hr, int hll,
+                                                         Node* left_r, int hlrl)
+{
+  uint64_t version = node->version_.load();
+  uint64_t left_version = left->version_.load();
+  Node* parent_l = parent->child(true);
+  Node* left_rl = left_r->child(true);
+  Node* left_rr = left_r->child(false);
+  int hlrr = height(left_rr);
+
+  node->version_.store(begin_shrink(version));
+  left->version_.store(begin_shrink(left_version));
+
+  node->child(true, left_rr);
+  if (left_rr) left_rr->parent_.store(node);
+  left->child(false, left_rl);
+  if (left_rl) left_rl->parent_.store(left);
+  left_r->child(true, left);
+  left->parent_.store(left_r);
+  left_r->child(false, node);
+  node->parent_.store(left_r);
+  parent->child(parent_l == node, left_r);
+  left_r->parent_.store(parent);
+
+  int hn_repl = 1 + std::max(hlrr, hr);
+  node->height_.store(hn_repl);
+  int hl_repl = 1 + std::max(hll, hlrl);
+  left->height_.store(hl_repl);
+  left_r->height_.store(1 + std::max(hl_repl, hn_repl));
+
+  node->version_.store(end_shrink(version));
+  left->version_.store(end_shrink(left_version));
+
+  int bal_n = hlrr - hr;
+  if (bal_n < -1 || bal_n > 1) return node;
+  if ((!left_rr || hr == 0) && !node->present_.load()) return node;
+
+  int bal_lr = hl_repl - hn_repl;
+  if (bal_lr < -1 || bal_lr > 1) return left_r;
+
+  return fix_height_nl(parent);
+}
+
+template <typename K, typename V, typename Comp>
+typename ConcurrentAVLTree<K, V, Comp>::Node*
+ConcurrentAVLTree<K, V, Comp>::rotate_left_over_right_nl(Node* parent, Node* node,
+                                                         int hl, Node* right, Node* right_l,
+                                                         int hrr, int hrlr)
+{
+  uint64_t version = node->version_.load();
+  uint64_t right_version = right->version_.load();
+  Node* parent_l = parent->child(true);
+  Node* right_ll = right_l->child(true);
+  Node* right_lr = right_l->child(false);
+  int hrll = height(right_ll);
+
+  node->version_.store(begin_shrink(version));
+  right->version_.store(begin_shrink(right_version));
+
+  node->child(false, right_ll);
+  if (right_ll) right_ll->parent_.store(node);
+  right->child(true, right_lr);
+  if (right_lr) right_lr->parent_.store(right);
+  right_l->child(false, right);
+  right->parent_.store(right_l);
+  right_l->child(true, node);
+  node->parent_.store(right_l);
+  parent->child(parent_l == node, right_l);
+  right_l->parent_.store(parent);
+
+  int hn_repl = 1 + std::max(hl, hrll);
+  node->height_.store(hn_repl);
+  int hr_repl = 1 + std::max(hrlr, hrr);
+  right->height_.store(hr_repl);
+  right_l->height_.store(1 + std::max(hn_repl, hr_repl));
+
+  node->version_.store(end_shrink(version));
+  right->version_.store(end_shrink(right_version));
+
+  int bal_n = hrll - hl;
+  if (bal_n < -1 || bal_n > 1) return node;
+  if ((!right_ll || hl == 0) && !node->present_.load()) return node;
+
+  int bal_rl = hr_repl - hn_repl;
+  if (bal_rl < -1 || bal_rl > 1) return right_l;
+
+  return fix_height_nl(parent);
+}
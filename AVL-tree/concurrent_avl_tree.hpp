@@ -0,0 +1,297 @@
+#ifndef CONCURRENT_AVL_TREE_HPP
+#define CONCURRENT_AVL_TREE_HPP
+/*!
+ * Concurrent ordered map after "A Practical Concurrent Binary
+ * Search Tree" by Nathan G. Bronson, Jared Casper, Hassan Chafi
+ * and Kunle Olukotun (PPoPP 2010).
+ *
+ * - Lookups take no locks. They walk hand-over-hand and validate
+ *   every step against the version of the node they came from;
+ *   a rotation bumps the version of the node it moves down
+ *   ("shrinks"), forcing affected readers to retry locally.
+ * - Writers lock only the nodes they modify.
+ * - Balance is relaxed: heights are repaired after the update by
+ *   the same single/double rotations as AVLTree_Base, which may
+ *   briefly lag behind concurrent updates.
+ * - Erasing a node with two children leaves a routing node
+ *   (no value) which is unlinked once it has at most one child.
+ *
+ * Unlinked nodes may still be traversed by concurrent readers,
+ * so they are freed by epoch based reclamation (Fraser, "Practical
+ * lock-freedom"): every operation announces the global epoch in a
+ * slot it claims for its duration, a node unlinked in epoch e goes
+ * to the retire list of that slot and is deleted once the global
+ * epoch reached e + 2, when no operation that could have seen it
+ * is still running. The epoch advances when every active slot
+ * announces it. At most epoch_slots operations run at once, more
+ * wait for a free slot.
+ *
+ * Requirements: ValueT is trivially copyable (it is read
+ * optimistically) and KeyT is default constructible (for the
+ * root holder).
+ */
+
+#if __cplusplus < 201103L
+  #error This header needs atleast a C++11 compliant compiler.
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ds {
+
+namespace detail {
+
+// One byte test-and-test-and-set lock
+class SpinLock
+{
+public:
+  void lock() noexcept {
+    while (true) {
+      if (!locked_.exchange(true, std::memory_order_acquire)) return;
+      while (locked_.load(std::memory_order_relaxed)) std::this_thread::yield();
+    }
+  }
+  void unlock() noexcept { locked_.store(false, std::memory_order_release); }
+
+private:
+  std::atomic<bool> locked_{false};
+};
+
+} // END namespace detail
+
+/*
+ * @class ConcurrentAVLTree
+ * Thread safe ordered map with the key/value/Comparator shape
+ * of AVLTree_Base.
+ *
+ * Exposed API's:
+ * 1. find(key, value)   - Lock free lookup, copies the value out.
+ * 2. insert(value)      - Returns false if the key is present.
+ * 3. insert_or_assign(value) - Returns true if the key was absent.
+ * 4. erase(key)         - Returns false if the key is absent.
+ * 5. size()             - Number of keys, exact when quiescent.
+ * 6. retired_nodes()    - Unlinked nodes not freed yet, for tests.
+ */
+template <typename KeyT, typename ValueT,
+	  typename Comparator = std::less<KeyT>>
+class ConcurrentAVLTree
+{
+public:
+  using key_type = KeyT;
+  using value_type = std::pair<KeyT, ValueT>;
+
+  static_assert (std::is_trivially_copyable<ValueT>::value,
+                 "Values are read optimistically and must be trivially copyable");
+
+public:
+  ConcurrentAVLTree() = default;
+  ConcurrentAVLTree(const ConcurrentAVLTree&) = delete;
+  void operator=(const ConcurrentAVLTree&) = delete;
+  ~ConcurrentAVLTree();
+
+public:
+  bool find(const KeyT& key, ValueT& value) const;
+
+  bool insert(const value_type& value) {
+    return update(value.first, UpdateMode::Insert, &value.second);
+  }
+
+  bool insert_or_assign(const value_type& value) {
+    return update(value.first, UpdateMode::Assign, &value.second);
+  }
+
+  bool erase(const KeyT& key) {
+    return update(key, UpdateMode::Erase, nullptr);
+  }
+
+  size_t size() const noexcept {
+    auto sz = size_.load(std::memory_order_relaxed);
+    return sz < 0 ? 0 : static_cast<size_t>(sz);
+  }
+
+  // Height of the tree, for tests. Not thread safe.
+  int height() const noexcept { return height(root_holder_.right_.load()); }
+
+  // Not thread safe
+  size_t retired_nodes() const noexcept {
+    size_t n = 0;
+    for (auto& slot : slots_) n += slot.retired_.size();
+    return n;
+  }
+
+private:
+  /*
+   * Version (the "OVL" of the paper) of a node:
+   * bit 1 is set while a rotation shrinks the subtree of the
+   * node, every finished shrink adds shrink_incr.
+   * An unlinked node has the version `unlinked` forever.
+   */
+  static constexpr uint64_t unlinked = 1;
+  static constexpr uint64_t shrinking = 2;
+  static constexpr uint64_t shrink_incr = 4;
+
+  static bool is_shrinking_or_unlinked(uint64_t v) noexcept {
+    return (v & (shrinking | unlinked)) != 0;
+  }
+  static bool is_unlinked(uint64_t v) noexcept { return v == unlinked; }
+  static uint64_t begin_shrink(uint64_t v) noexcept { return v | shrinking; }
+  static uint64_t end_shrink(uint64_t v) noexcept { return (v & ~shrinking) + shrink_incr; }
+
+  struct Node {
+    Node() = default;
+    Node(const KeyT& k, const ValueT& v, Node* parent):
+      key_(k)
+    {
+      value_.store(v, std::memory_order_relaxed);
+      present_.store(true, std::memory_order_relaxed);
+      parent_.store(parent, std::memory_order_relaxed);
+      height_.store(1, std::memory_order_relaxed);
+    }
+
+    Node* child(bool left) const noexcept {
+      return (left ? left_ : right_).load(std::memory_order_acquire);
+    }
+    void child(bool left, Node* node) noexcept {
+      (left ? left_ : right_).store(node, std::memory_order_release);
+    }
+
+    const KeyT key_{};
+    std::atomic<int> height_{0};
+    std::atomic<uint64_t> version_{0};
+    // Sequence lock guarding (present_, value_) for lock free
+    // readers; written only with the node lock held
+    std::atomic<uint32_t> vseq_{0};
+    std::atomic<bool> present_{false};
+    std::atomic<ValueT> value_{};
+    std::atomic<Node*> parent_{nullptr};
+    std::atomic<Node*> left_{nullptr};
+    std::atomic<Node*> right_{nullptr};
+    detail::SpinLock lock_;
+  };
+
+  using LockGuard = std::lock_guard<detail::SpinLock>;
+
+  static constexpr size_t epoch_slots = 64;
+  // Retire list length at which an operation tries to reclaim
+  static constexpr size_t reclaim_batch = 64;
+
+  struct EpochSlot {
+    // 0 while free, else (announced epoch << 1) | 1
+    std::atomic<uint64_t> state_{0};
+    // (epoch of the unlink, node), owned by the holder of the slot
+    std::vector<std::pair<uint64_t, Node*>> retired_;
+    // Keeps the announcements of two slots off one cache line
+    char pad_[64];
+  };
+
+  // Holds an epoch slot for the duration of one operation
+  class EpochGuard
+  {
+  public:
+    explicit EpochGuard(const ConcurrentAVLTree& tree):
+      tree_(tree),
+      slot_(tree.enter_epoch())
+    {
+      current_slot() = slot_;
+    }
+    EpochGuard(const EpochGuard&) = delete;
+    void operator=(const EpochGuard&) = delete;
+    ~EpochGuard() {
+      current_slot() = nullptr;
+      tree_.leave_epoch(slot_);
+    }
+
+  private:
+    const ConcurrentAVLTree& tree_;
+    EpochSlot* slot_;
+  };
+
+  enum class UpdateMode { Insert, Assign, Erase };
+
+  // Result of the optimistic attempts
+  enum class Attempt { Retry, Found, NotFound, Updated, Unchanged };
+
+  // Special results of node_condition(), other values are the
+  // height the node should have
+  static constexpr int unlink_required = -1;
+  static constexpr int rebalance_required = -2;
+  static constexpr int nothing_required = -3;
+
+private:
+  static int height(const Node* node) noexcept {
+    return node ? node->height_.load(std::memory_order_relaxed) : 0;
+  }
+
+  // -1, 0, 1 as key is less, equal or greater than node's key
+  int compare(const KeyT& key, const Node* node) const {
+    if (compare_(key, node->key_)) return -1;
+    if (compare_(node->key_, key)) return 1;
+    return 0;
+  }
+
+  static bool read_value(const Node* node, ValueT* value);
+  static void write_value(Node* node, bool present, const ValueT* value);
+
+  static void wait_until_shrink_completed(const Node* node, uint64_t version);
+
+  Attempt attempt_get(const KeyT& key, const Node* node, bool dir_left,
+                      uint64_t node_version, ValueT& value) const;
+
+  bool update(const KeyT& key, UpdateMode mode, const ValueT* value);
+  bool attempt_insert_into_empty(const KeyT& key, const ValueT* value);
+  Attempt attempt_update(const KeyT& key, UpdateMode mode, const ValueT* value,
+                         Node* parent, Node* node, uint64_t node_version);
+  Attempt attempt_node_update(UpdateMode mode, const ValueT* value,
+                              Node* parent, Node* node);
+  bool attempt_unlink_nl(Node* parent, Node* node);
+  void retire(Node* node);
+  EpochSlot* enter_epoch() const;
+  void leave_epoch(EpochSlot* slot) const;
+  void reclaim(EpochSlot& slot) const;
+  bool try_advance_epoch() const;
+
+  // Slot of the operation the calling thread is running
+  static EpochSlot*& current_slot() noexcept {
+    static thread_local EpochSlot* slot = nullptr;
+    return slot;
+  }
+
+  static int node_condition(Node* node);
+  void fix_height_and_rebalance(Node* node);
+  Node* fix_height_nl(Node* node);
+  Node* rebalance_nl(Node* parent, Node* node);
+  Node* rebalance_to_right_nl(Node* parent, Node* node, Node* left, int hr0);
+  Node* rebalance_to_left_nl(Node* parent, Node* node, Node* right, int hl0);
+  Node* rotate_right_nl(Node* parent, Node* node, Node* left, int hr, int hll,
+                        Node* left_r, int hlr);
+  Node* rotate_left_nl(Node* parent, Node* node, int hl, Node* right,
+                       Node* right_l, int hrl, int hrr);
+  Node* rotate_right_over_left_nl(Node* parent, Node* node, Node* left, int hr,
+                                  int hll, Node* left_r, int hlrl);
+  Node* rotate_left_over_right_nl(Node* parent, Node* node, int hl, Node* right,
+                                  Node* right_l, int hrr, int hrlr);
+
+  static void destroy(Node* node);
+
+private:
+  // Sentinel whose right child is the root
+  mutable Node root_holder_;
+  std::atomic<long> size_{0};
+  Comparator compare_;
+
+  mutable std::atomic<uint64_t> epoch_{0};
+  mutable EpochSlot slots_[epoch_slots];
+};
+
+}// end namespace ds
+
+#endif
@@ -0,0 +1,107 @@
+#include "frozen_avl_tree.hpp"
+using namespace ds;
+
+template <typename K, typename V, typename Comp>
+constexpr size_t FrozenAVLTree<K, V, Comp>::cache_line;
+
+template <typename K, typename V, typename Comp>
+constexpr size_t FrozenAVLTree<K, V, Comp>::line_keys;
+
+template <typename K, typename V, typename Comp>
+template <typename Iter>
+FrozenAVLTree<K, V, Comp>::FrozenAVLTree(Iter first, Iter last):
+  size_(std::distance(first, last))
+{
+  key_store_.resize(size_ + 1 + line_keys);
+  values_.resize(size_ + 1);
+
+  auto addr = reinterpret_cast<uintptr_t>(key_store_.data());
+  if (cache_line % sizeof(K) == 0 && addr % sizeof(K) == 0) {
+    key_base_ = ((cache_line - addr % cache_line) % cache_line) / sizeof(K);
+  }
+  // Positions are filled in order by an in order walk of the
+  // implicit tree, consuming the sorted input front to back
+  fill(first, 1);
+  assert (first == last);
+}
+
+template <typename K, typename V, typename Comp>
+template <typename Iter>
+void FrozenAVLTree<K, V, Comp>::fill(Iter& it, size_t pos)
+{
+  if (pos > size_) return;
+  fill(it, 2 * pos);
+  key_store_[key_base_ + pos] = it->first;
+  values_[pos] = it->second;
+  ++it;
+  fill(it, 2 * pos + 1);
+}
+
+template <typename K, typename V, typename Comp>
+size_t FrozenAVLTree<K, V, Comp>::lower_bound_pos(const K& key) const
+{
+  const K* base = keys();
+  size_t pos = 1;
+  while (pos <= size_) {
+#if defined(__GNUC__)
+    // Only a hint, may point past the end
+    __builtin_prefetch(reinterpret_cast<const char*>(base) +
+                       pos * line_keys * sizeof(K));
+#endif
+    pos = 2 * pos + compare_(base[pos], key);
+  }
+  // pos encodes the path taken, one bit per level, 1 being a
+  // step right. The lower bound is the node where the path last
+  // turned left: strip the trailing right turns and that left turn.
+#if defined(__GNUC__)
+  pos >>= __builtin_ffsll(~static_cast<unsigned long long>(pos));
+#else
+  while (pos & 1) pos >>= 1;
+  pos >>= 1;
+#endif
+  return pos;
+}
+
+template <typename K, typename V, typename Comp>
+const V* FrozenAVLTree<K, V, Comp>::find(const K& key) const
+{
+  size_t pos = lower_bound_pos(key);
+  if (pos == 0 || compare_(key, keys()[pos])) return nullptr;
+  return &values_[pos];
+}
+
+template <typename K, typename V, typename Comp>
+size_t FrozenAVLTree<K, V, Comp>::next(size_t pos) const noexcept
+{
+  if (2 * pos + 1 <= size_) {
+    // Leftmost node of the right subtree
+    pos = 2 * pos + 1;
+    while (2 * pos <= size_) pos = 2 * pos;
+    return pos;
+  }
+  // Up to the first ancestor we are in the left subtree of
+  while (pos & 1) pos >>= 1;
+  return pos >> 1;
+}
+
+template <typename K, typename V, typename Comp>
+typename FrozenAVLTree<K, V, Comp>::const_iterator
+FrozenAVLTree<K, V, Comp>::begin() const
+{
+  if (size_ == 0) return end();
+  size_t pos = 1;
+  while (2 * pos <= size_) pos = 2 * pos;
+  return const_iterator(this, pos);
+}
+
+template <typename K, typename V, typename Comp>
+template <typename F>
+void FrozenAVLTree<K, V, Comp>::for_each_in_range(const K& lo, const K& hi, F&& f) const
+{
+  const K* base = keys();
+  for (size_t pos = lower_bound_pos(lo);
+       pos != 0 && compare_(base[pos], hi);
+       pos = next(pos)) {
+    f(base[pos], values_[pos]);
+  }
+}
@@ -0,0 +1,133 @@
+#ifndef FROZEN_AVL_TREE_HPP
+#define FROZEN_AVL_TREE_HPP
+
+#if __cplusplus < 201103L
+  #error This header needs atleast a C++11 compliant compiler.
+#endif
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace ds {
+
+/*
+ * @class FrozenAVLTree
+ * Read only snapshot of an ordered map, see AVLTree_Base::freeze().
+ * Keys are laid out in Eytzinger (BFS) order: the children of
+ * position i are 2i and 2i + 1, position 0 is unused and doubles
+ * as end(). Values sit in a parallel array, so a search only
+ * touches keys.
+ *
+ * The search is branch free: every level costs one compare
+ * folded into the next index. Keys are 64 byte aligned, so the
+ * 64 / sizeof(KeyT) nodes log2(64 / sizeof(KeyT)) levels below
+ * position i share one cache line, which is prefetched while the
+ * levels in between are being walked.
+ *
+ * Exposed API's:
+ * 1. find(key)        - Returns nullptr if the key is not present.
+ * 2. lower_bound(key) - Iterator to the first key not less than key.
+ * 3. begin()/end()    - In order iteration, amortised O(1) per step.
+ * 4. for_each_in_range(lo, hi, f) - Calls f(key, value) for every
+ *                       key in [lo, hi) in ascending order.
+ */
+template <typename KeyT, typename ValueT,
+	  typename Comparator = std::less<KeyT>>
+class FrozenAVLTree
+{
+public:
+  using key_type = KeyT;
+  using value_type = std::pair<KeyT, ValueT>;
+
+  static constexpr size_t cache_line = 64;
+  static constexpr size_t line_keys =
+    sizeof(KeyT) < cache_line ? cache_line / sizeof(KeyT) : 1;
+
+  class const_iterator
+  {
+  public:
+    const_iterator() = default;
+
+    const KeyT& key() const noexcept { return tree_->keys()[pos_]; }
+    const ValueT& value() const noexcept { return tree_->values_[pos_]; }
+
+    const_iterator& operator++() noexcept {
+      pos_ = tree_->next(pos_);
+      return *this;
+    }
+
+    bool operator==(const const_iterator& other) const noexcept {
+      return pos_ == other.pos_;
+    }
+    bool operator!=(const const_iterator& other) const noexcept {
+      return pos_ != other.pos_;
+    }
+
+  private:
+    friend class FrozenAVLTree;
+    const_iterator(const FrozenAVLTree* tree, size_t pos):
+      tree_(tree),
+      pos_(pos)
+    {}
+
+    const FrozenAVLTree* tree_ = nullptr;
+    size_t pos_ = 0;
+  };
+
+public:
+  FrozenAVLTree() = default;
+
+  // [first, last) must be strictly increasing by key
+  template <typename Iter>
+  FrozenAVLTree(Iter first, Iter last);
+
+  FrozenAVLTree(const FrozenAVLTree&) = delete;
+  void operator=(const FrozenAVLTree&) = delete;
+  FrozenAVLTree(FrozenAVLTree&&) = default;
+  FrozenAVLTree& operator=(FrozenAVLTree&&) = default;
+
+public:
+  const ValueT* find(const KeyT& key) const;
+
+  const_iterator lower_bound(const KeyT& key) const {
+    return const_iterator(this, lower_bound_pos(key));
+  }
+
+  const_iterator begin() const;
+  const_iterator end() const { return const_iterator(this, 0); }
+
+  template <typename F>
+  void for_each_in_range(const KeyT& lo, const KeyT& hi, F&& f) const;
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+private:
+  // Keys indexed by Eytzinger position, keys()[0] is unused
+  const KeyT* keys() const noexcept { return key_store_.data() + key_base_; }
+
+  size_t lower_bound_pos(const KeyT& key) const;
+
+  // In order successor of position pos, 0 after the last one
+  size_t next(size_t pos) const noexcept;
+
+  template <typename Iter>
+  void fill(Iter& it, size_t pos);
+
+private:
+  // Over allocated by a cache line so that keys() can be aligned
+  std::vector<KeyT> key_store_;
+  size_t key_base_ = 0;
+  std::vector<ValueT> values_;
+  size_t size_ = 0;
+  Comparator compare_;
+};
+
+}// end namespace ds
+
+#endif
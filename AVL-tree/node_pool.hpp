@@ -0,0 +1,155 @@
+#ifndef NODE_POOL_HPP
+#define NODE_POOL_HPP
+
+#if __cplusplus < 201103L
+  #error This header needs atleast a C++11 compliant compiler.
+#endif
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ds {
+
+/*
+ * @class NodePool
+ * Arena which hands out nodes by 32 bit index instead of pointer.
+ * Nodes are carved out of fixed size chunks, so a node never moves
+ * once created and references to it stay valid while other nodes
+ * are being created.
+ * Index 0 is never handed out and serves as the null index.
+ *
+ * Exposed API's:
+ * 1. create(args...) - Constructs a node and returns its index.
+ * 2. destroy(idx)    - Runs the destructor and recycles the slot.
+ * 3. operator[](idx) - Index to node.
+ * 4. release()       - Bulk teardown. Frees every chunk at once
+ *                      without running destructors; callers holding
+ *                      non trivially destructible nodes are expected
+ *                      to destroy() them first.
+ */
+template <typename NodeT, uint32_t ChunkBits = 10>
+class NodePool
+{
+public:
+  using index_type = uint32_t;
+  static constexpr index_type null_index = 0;
+  static constexpr index_type chunk_size = index_type(1) << ChunkBits;
+
+public:
+  NodePool() = default;
+  NodePool(const NodePool&) = delete;
+  void operator=(const NodePool&) = delete;
+  ~NodePool() { release(); }
+
+public:
+  template <typename... Args>
+  index_type create(Args&&... args) {
+    index_type idx = free_head_;
+    if (idx != null_index) {
+      free_head_ = *reinterpret_cast<index_type*>(slot(idx));
+    } else {
+      // next_ wraps to the null index once every index is handed out
+      if (next_ == null_index) throw std::length_error("node pool exhausted its 32 bit indices");
+      if ((next_ >> ChunkBits) == chunks_.size()) {
+        chunks_.emplace_back(new Storage[chunk_size]);
+      }
+      idx = next_++;
+    }
+    new (slot(idx)) NodeT(std::forward<Args>(args)...);
+    return idx;
+  }
+
+  void destroy(index_type idx) noexcept {
+    assert (idx != null_index);
+    (*this)[idx].~NodeT();
+    push_free(idx);
+  }
+
+  NodeT& operator[](index_type idx) noexcept {
+    return *reinterpret_cast<NodeT*>(slot(idx));
+  }
+
+  const NodeT& operator[](index_type idx) const noexcept {
+    return *reinterpret_cast<const NodeT*>(slot(idx));
+  }
+
+  void release() noexcept {
+    chunks_.clear();
+    next_ = 1;
+    free_head_ = null_index;
+  }
+
+  /*
+   * Takes over every chunk of `other` without copying any node;
+   * `other` is left empty. Node `i` of `other` becomes node
+   * `i + offset` of this pool, the returned offset. The unused
+   * tail of our last chunk is put on the free list.
+   */
+  index_type adopt(NodePool& other) {
+    assert (&other != this);
+    if (other.chunks_.empty()) return 0;
+
+    const index_type offset = chunks_.size() * chunk_size;
+    assert ((uint64_t(offset) + other.chunks_.size() * chunk_size) >> 32 == 0);
+    for (index_type idx = next_; idx < offset; idx++) push_free(idx);
+
+    for (auto& chunk : other.chunks_) chunks_.push_back(std::move(chunk));
+    // Slot 0 of `other` was never handed out
+    if (offset != null_index) push_free(offset);
+    auto idx = other.free_head_;
+    while (idx != null_index) {
+      auto nxt = *reinterpret_cast<index_type*>(slot(idx + offset));
+      push_free(idx + offset);
+      idx = nxt;
+    }
+    next_ = offset + other.next_;
+    other.chunks_.clear();
+    other.release();
+    return offset;
+  }
+
+  // Bytes reserved by the pool
+  size_t capacity_bytes() const noexcept {
+    return chunks_.size() * chunk_size * sizeof(Storage);
+  }
+
+private:
+  using Storage = typename std::aligned_storage<sizeof(NodeT), alignof(NodeT)>::type;
+  static_assert (sizeof(Storage) >= sizeof(index_type),
+                 "Free slots are chained through the node storage");
+
+  Storage* slot(index_type idx) const noexcept {
+    return &chunks_[idx >> ChunkBits][idx & (chunk_size - 1)];
+  }
+
+  void push_free(index_type idx) noexcept {
+    *reinterpret_cast<index_type*>(slot(idx)) = free_head_;
+    free_head_ = idx;
+  }
+
+private:
+  std::vector<std::unique_ptr<Storage[]>> chunks_;
+  // Bump index for never used slots, slot 0 is the null index
+  index_type next_ = 1;
+  // Head of the list of destroyed slots
+  index_type free_head_ = null_index;
+};
+
+template <typename NodeT, uint32_t ChunkBits>
+constexpr typename NodePool<NodeT, ChunkBits>::index_type
+NodePool<NodeT, ChunkBits>::null_index;
+
+template <typename NodeT, uint32_t ChunkBits>
+constexpr typename NodePool<NodeT, ChunkBits>::index_type
+NodePool<NodeT, ChunkBits>::chunk_size;
+
+}// end namespace ds
+
+#endif
@@ -0,0 +1,155 @@
+#include "persistent_avl_tree.hpp"
+using namespace ds;
+
+template <typename K, typename V, typename Comp>
+PersistentAVLTree<K, V, Comp>
+PersistentAVLTree<K, V, Comp>::insert(const value_type& value) const
+{
+  bool inserted = false;
+  auto root = do_insert(root_, value, inserted);
+  if (!inserted) return *this;
+  return PersistentAVLTree(std::move(root), size_ + 1);
+}
+
+template <typename K, typename V, typename Comp>
+PersistentAVLTree<K, V, Comp>
+PersistentAVLTree<K, V, Comp>::erase(const K& key) const
+{
+  bool erased = false;
+  auto root = do_erase(root_, key, erased);
+  if (!erased) return *this;
+  return PersistentAVLTree(std::move(root), size_ - 1);
+}
+
+template <typename K, typename V, typename Comp>
+const V* PersistentAVLTree<K, V, Comp>::find(const K& key) const
+{
+  const Node* node = root_.get();
+  while (node) {
+    if (compare_(key, node->key())) {
+      node = node->left_.get();
+    } else if (compare_(node->key(), key)) {
+      node = node->right_.get();
+    } else {
+      return &node->value_.second;
+    }
+  }
+  return nullptr;
+}
+
+/*
+ * New node for v over subtrees l and r whose heights differ by at
+ * most 2, rotated back into balance. Only the nodes that change
+ * are allocated, untouched subtrees are shared.
+ */
+template <typename K, typename V, typename Comp>
+typename PersistentAVLTree<K, V, Comp>::NodePtr
+PersistentAVLTree<K, V, Comp>::balance(const value_type& v, NodePtr l, NodePtr r)
+{
+  size_t hl = height(l);
+  size_t hr = height(r);
+
+  if (hl > hr + 1) {
+    if (height(l->left_) >= height(l->right_)) {
+      // Left-Left: single right rotation
+      return make_node(l->value_, l->left_, make_node(v, l->right_, std::move(r)));
+    }
+    // Left-Right: double rotation
+    const Node* lr = l->right_.get();
+    return make_node(lr->value_,
+                     make_node(l->value_, l->left_, lr->left_),
+                     make_node(v, lr->right_, std::move(r)));
+  }
+
+  if (hr > hl + 1) {
+    if (height(r->right_) >= height(r->left_)) {
+      // Right-Right: single left rotation
+      return make_node(r->value_, make_node(v, std::move(l), r->left_), r->right_);
+    }
+    // Right-Left: double rotation
+    const Node* rl = r->left_.get();
+    return make_node(rl->value_,
+                     make_node(v, std::move(l), rl->left_),
+                     make_node(r->value_, rl->right_, r->right_));
+  }
+
+  return make_node(v, std::move(l), std::move(r));
+}
+
+template <typename K, typename V, typename Comp>
+typename PersistentAVLTree<K, V, Comp>::NodePtr
+PersistentAVLTree<K, V, Comp>::do_insert(const NodePtr& node, const value_type& value,
+                                         bool& inserted) const
+{
+  if (!node) {
+    inserted = true;
+    return make_node(value, nullptr, nullptr);
+  }
+
+  if (compare_(value.first, node->key())) {
+    auto l = do_insert(node->left_, value, inserted);
+    if (!inserted) return node;
+    return balance(node->value_, std::move(l), node->right_);
+  }
+  if (compare_(node->key(), value.first)) {
+    auto r = do_insert(node->right_, value, inserted);
+    if (!inserted) return node;
+    return balance(node->value_, node->left_, std::move(r));
+  }
+  return node;
+}
+
+template <typename K, typename V, typename Comp>
+typename PersistentAVLTree<K, V, Comp>::NodePtr
+PersistentAVLTree<K, V, Comp>::do_erase(const NodePtr& node, const K& key,
+                                        bool& erased) const
+{
+  if (!node) return node;
+
+  if (compare_(key, node->key())) {
+    auto l = do_erase(node->left_, key, erased);
+    if (!erased) return node;
+    return balance(node->value_, std::move(l), node->right_);
+  }
+  if (compare_(node->key(), key)) {
+    auto r = do_erase(node->right_, key, erased);
+    if (!erased) return node;
+    return balance(node->value_, node->left_, std::move(r));
+  }
+
+  erased = true;
+  if (!node->left_) return node->right_;
+  if (!node->right_) return node->left_;
+
+  // Splice in the in-order successor
+  const Node* succ = nullptr;
+  auto r = erase_min(node->right_, succ);
+  return balance(succ->value_, node->left_, std::move(r));
+}
+
+// `min` stays alive through the old version holding it
+template <typename K, typename V, typename Comp>
+typename PersistentAVLTree<K, V, Comp>::NodePtr
+PersistentAVLTree<K, V, Comp>::erase_min(const NodePtr& node, const Node*& min)
+{
+  if (!node->left_) {
+    min = node.get();
+    return node->right_;
+  }
+  auto l = erase_min(node->left_, min);
+  return balance(node->value_, std::move(l), node->right_);
+}
+
+template <typename K, typename V, typename Comp>
+template <typename F>
+void PersistentAVLTree<K, V, Comp>::do_for_each_in_range(
+    const Node* node, const K& lo, const K& hi, F& f) const
+{
+  if (!node) return;
+  bool above_lo = !compare_(node->key(), lo);
+  bool below_hi = compare_(node->key(), hi);
+
+  if (above_lo) do_for_each_in_range(node->left_.get(), lo, hi, f);
+  if (above_lo && below_hi) f(node->key(), node->value_.second);
+  if (below_hi) do_for_each_in_range(node->right_.get(), lo, hi, f);
+}
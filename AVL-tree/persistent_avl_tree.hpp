@@ -0,0 +1,177 @@
+#ifndef PERSISTENT_AVL_TREE_HPP
+#define PERSISTENT_AVL_TREE_HPP
+/*!
+ * Persistent (path copying) AVL tree.
+ *
+ * Nodes are immutable and shared between versions through
+ * reference counting. insert/erase copy the O(log n) nodes on the
+ * search path, rebalancing the copies with the usual single and
+ * double rotations, and return a new version; every older version
+ * stays valid and unchanged. A node is freed once the last version
+ * referring to it goes away.
+ *
+ * SnapshotAVLMap puts a single current version behind an atomic
+ * shared_ptr so that readers can grab a consistent point in time
+ * view while writers keep going.
+ */
+
+#if __cplusplus < 201103L
+  #error This header needs atleast a C++11 compliant compiler.
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace ds {
+
+/*
+ * @class PersistentAVLTree
+ * Immutable ordered map. Cheap to copy, copies share all nodes.
+ *
+ * Exposed API's:
+ * 1. insert(value) - New version with value, *this if the key exists.
+ * 2. erase(key)    - New version without key.
+ * 3. find(key)     - Pointer to the value, valid while any version
+ *                    holding it is alive.
+ * 4. for_each_in_range(lo, hi, f) - f(key, value) over [lo, hi) in order.
+ * 5. size(), empty(), height()
+ */
+template <typename KeyT, typename ValueT,
+	  typename Comparator = std::less<KeyT>>
+class PersistentAVLTree
+{
+public:
+  using key_type = KeyT;
+  using value_type = std::pair<KeyT, ValueT>;
+
+public:
+  PersistentAVLTree() = default;
+
+public:
+  PersistentAVLTree insert(const value_type& value) const;
+  PersistentAVLTree erase(const KeyT& key) const;
+
+  const ValueT* find(const KeyT& key) const;
+
+  template <typename F>
+  void for_each_in_range(const KeyT& lo, const KeyT& hi, F&& f) const {
+    do_for_each_in_range(root_.get(), lo, hi, f);
+  }
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  size_t height() const noexcept { return height(root_); }
+
+private:
+  struct Node;
+  using NodePtr = std::shared_ptr<const Node>;
+
+  struct Node {
+    Node(const value_type& v, NodePtr l, NodePtr r):
+      value_(v),
+      left_(std::move(l)),
+      right_(std::move(r)),
+      height_(1 + std::max(PersistentAVLTree::height(left_),
+                           PersistentAVLTree::height(right_)))
+    {}
+
+    const KeyT& key() const noexcept { return value_.first; }
+
+    value_type value_;
+    NodePtr left_;
+    NodePtr right_;
+    uint8_t height_;
+  };
+
+  PersistentAVLTree(NodePtr root, size_t size):
+    root_(std::move(root)),
+    size_(size)
+  {}
+
+  static size_t height(const NodePtr& node) noexcept {
+    return node ? node->height_ : 0;
+  }
+
+  static NodePtr make_node(const value_type& v, NodePtr l, NodePtr r) {
+    return std::make_shared<const Node>(v, std::move(l), std::move(r));
+  }
+
+  static NodePtr balance(const value_type& v, NodePtr l, NodePtr r);
+
+  NodePtr do_insert(const NodePtr& node, const value_type& value, bool& inserted) const;
+  NodePtr do_erase(const NodePtr& node, const KeyT& key, bool& erased) const;
+  static NodePtr erase_min(const NodePtr& node, const Node*& min);
+
+  template <typename F>
+  void do_for_each_in_range(const Node* node, const KeyT& lo, const KeyT& hi,
+                            F& f) const;
+
+private:
+  NodePtr root_;
+  size_t size_ = 0;
+  Comparator compare_;
+};
+
+/*
+ * @class SnapshotAVLMap
+ * Mutable map over PersistentAVLTree versions.
+ * Readers never wait for writers: snapshot() returns the current
+ * version, which no later write can change. Writers are serialized
+ * and publish each new version atomically.
+ *
+ * Exposed API's:
+ * 1. snapshot()    - The current version.
+ * 2. insert(value) - Returns false if the key is present.
+ * 3. erase(key)    - Returns false if the key is absent.
+ */
+template <typename KeyT, typename ValueT,
+	  typename Comparator = std::less<KeyT>>
+class SnapshotAVLMap
+{
+public:
+  using TreeType = PersistentAVLTree<KeyT, ValueT, Comparator>;
+  using value_type = typename TreeType::value_type;
+
+public:
+  SnapshotAVLMap():
+    current_(std::make_shared<const TreeType>())
+  {}
+  SnapshotAVLMap(const SnapshotAVLMap&) = delete;
+  void operator=(const SnapshotAVLMap&) = delete;
+
+public:
+  std::shared_ptr<const TreeType> snapshot() const {
+    return std::atomic_load(&current_);
+  }
+
+  bool insert(const value_type& value) {
+    std::lock_guard<std::mutex> lk(write_mutex_);
+    return publish(current_->insert(value));
+  }
+
+  bool erase(const KeyT& key) {
+    std::lock_guard<std::mutex> lk(write_mutex_);
+    return publish(current_->erase(key));
+  }
+
+private:
+  // Write mutex must be held
+  bool publish(TreeType&& next) {
+    if (next.size() == current_->size()) return false;
+    std::atomic_store(&current_, std::make_shared<const TreeType>(std::move(next)));
+    return true;
+  }
+
+private:
+  std::shared_ptr<const TreeType> current_;
+  std::mutex write_mutex_;
+};
+
+}// end namespace ds
+
+#endif
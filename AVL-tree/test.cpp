@@ -1,6 +1,21 @@
 #include "avl_tree.hpp"
 #include "avl_tree.cpp"
+#include "frozen_avl_tree.cpp"
+#include "btree_map.hpp"
+#include "btree_map.cpp"
+#include "concurrent_avl_tree.hpp"
+#include "concurrent_avl_tree.cpp"
+#include "persistent_avl_tree.hpp"
+#include "persistent_avl_tree.cpp"
+#include <climits>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace ds;
 
@@ -12,17 +27,668 @@ void test_simple()
     map.insert(std::make_pair(i, i));
   }
   auto tmp = map.head();
-  auto ht = tmp->subtree_heights();
+  auto ht = map.subtree_heights(tmp);
   std::cout << "Left ht: " << ht.first << std::endl;
   std::cout << "Right ht: " << ht.second << std::endl;
-  assert (tmp->height() == 4);
+  assert (map.height(tmp) == 4);
   map.insert(std::make_pair(10, 10));
   tmp = map.head();
 
   std::cout << "=====End test_simple" << std::endl;
 }
 
+void test_node_layout()
+{
+  std::cout << "Start test_node_layout=====" << std::endl;
+  using Tree = AVLTree_Base<int, int>;
+  static_assert (sizeof(Tree::NodeType) <= 20, "Compact node layout");
+
+  Tree map;
+  assert (map.head() == Tree::null_index);
+  for (int i = 0; i < 5; i++) {
+    assert (map.insert(std::make_pair(i, -i)));
+  }
+  assert (!map.insert(std::make_pair(3, 0)));
+  assert (map.find(3) && *map.find(3) == -3);
+  map.clear();
+  assert (map.head() == Tree::null_index);
+  assert (map.find(3) == nullptr);
+
+  // Non trivially destructible values are torn down node by node
+  AVLTree_Base<int, std::string> smap;
+  for (int i = 0; i < 5; i++) {
+    smap.insert(std::make_pair(i, std::string(64, 'a' + i)));
+  }
+  assert (smap.find(3) && (*smap.find(3))[0] == 'd');
+  smap.clear();
+  smap.insert(std::make_pair(1, std::string("x")));
+  assert (smap.find(1) && *smap.find(1) == "x");
+
+  std::cout << "=====End test_node_layout" << std::endl;
+}
+
+// Checks ordering, stored heights and the AVL balance;
+// returns the height of the subtree
+template <typename Tree>
+uint32_t check_avl(const Tree& tree, typename Tree::index_type idx,
+                   const typename Tree::key_type* lo,
+                   const typename Tree::key_type* hi, size_t& count)
+{
+  if (idx == Tree::null_index) return 0;
+  auto& n = tree.node(idx);
+  assert (!lo || *lo < n.key());
+  assert (!hi || n.key() < *hi);
+  auto lh = check_avl(tree, n.left(), lo, &n.key(), count);
+  auto rh = check_avl(tree, n.right(), &n.key(), hi, count);
+  assert (n.height() == std::max(lh, rh) + 1);
+  assert (lh <= rh + 1 && rh <= lh + 1);
+  count++;
+  return n.height();
+}
+
+template <typename Tree>
+void check_avl(const Tree& tree)
+{
+  size_t count = 0;
+  check_avl(tree, tree.head(), nullptr, nullptr, count);
+  assert (count == tree.size());
+}
+
+void test_insert_erase()
+{
+  std::cout << "Start test_insert_erase=====" << std::endl;
+  AVLTree_Base<int, int> map;
+  for (int i = 0; i < 1000; i++) {
+    assert (map.insert(std::make_pair(i, -i)));
+  }
+  check_avl(map);
+  for (int i = 999; i >= 0; i -= 2) {
+    assert (map.erase(i));
+    assert (!map.erase(i));
+  }
+  check_avl(map);
+  for (int i = 0; i < 1000; i++) {
+    auto v = map.find(i);
+    assert ((i % 2 == 0) == (v != nullptr));
+    if (v) assert (*v == -i);
+  }
+
+  map.clear();
+  std::map<int, int> ref;
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> dist(0, 4000);
+  for (int i = 0; i < 20000; i++) {
+    auto k = dist(gen);
+    if (gen() % 3 == 0) {
+      assert (map.erase(k) == (ref.erase(k) == 1));
+    } else {
+      assert (map.insert(std::make_pair(k, i)) == ref.emplace(k, i).second);
+    }
+  }
+  check_avl(map);
+  assert (map.size() == ref.size());
+
+  std::vector<std::pair<int, int>> items;
+  map.for_each_in_range(0, 4001, [&items](int k, int v) { items.emplace_back(k, v); });
+  std::vector<std::pair<int, int>> expected(ref.begin(), ref.end());
+  assert (items == expected);
+
+  for (auto& e : ref) assert (map.erase(e.first));
+  assert (map.size() == 0 && map.head() == decltype(map)::null_index);
+
+  // A long ascending run rotates at every level on the way up
+  for (int i = 0; i < 5000; i++) {
+    assert (map.insert(std::make_pair(i, -i)));
+  }
+  check_avl(map);
+  assert (!map.insert(std::make_pair(42, 0)));
+  assert (map.find(42) && *map.find(42) == -42);
+
+  // Erasing nodes with two children moves values that own memory
+  AVLTree_Base<int, std::string> smap;
+  for (int i = 0; i < 200; i++) {
+    smap.insert(std::make_pair(i, std::string(64, 'a' + i % 26)));
+  }
+  for (int i = 0; i < 200; i += 3) assert (smap.erase(i));
+  check_avl(smap);
+  for (int i = 0; i < 200; i++) {
+    auto v = smap.find(i);
+    assert ((i % 3 != 0) == (v != nullptr));
+    if (v) assert (*v == std::string(64, 'a' + i % 26));
+  }
+
+  std::cout << "=====End test_insert_erase" << std::endl;
+}
+
+void test_order_statistic()
+{
+  std::cout << "Start test_order_statistic=====" << std::endl;
+  OrderStatisticTree<int, int> tree;
+  std::map<int, int> ref;
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<int> dist(0, 3000);
+
+  for (int i = 0; i < 20000; i++) {
+    auto k = dist(gen);
+    if (gen() % 4 == 0) {
+      assert (tree.erase(k) == (ref.erase(k) == 1));
+    } else {
+      assert (tree.insert(std::make_pair(k, i)) == ref.emplace(k, i).second);
+    }
+  }
+  check_avl(tree);
+  assert (tree.size() == ref.size());
+
+  size_t k = 0;
+  for (auto& e : ref) {
+    auto v = tree.select(k);
+    assert (v && v->first == e.first && v->second == e.second);
+    assert (tree.rank(e.first) == k);
+    k++;
+  }
+  assert (tree.select(ref.size()) == nullptr);
+  assert (tree.rank(-1) == 0);
+  assert (tree.rank(1 << 20) == ref.size());
+
+  for (int lo = -10; lo < 3010; lo += 97) {
+    for (int hi = lo; hi < 3010; hi += 301) {
+      auto expected = std::distance(ref.lower_bound(lo), ref.lower_bound(hi));
+      assert (tree.count_range(lo, hi) == (size_t)expected);
+    }
+  }
+  assert (tree.count_range(10, 5) == 0);
+
+  std::cout << "=====End test_order_statistic" << std::endl;
+}
+
+template <typename Tree>
+std::vector<int> keys_of(const Tree& tree)
+{
+  std::vector<int> keys;
+  tree.for_each_in_range(INT_MIN, INT_MAX, [&keys](int k, int) { keys.push_back(k); });
+  return keys;
+}
+
+template <typename Tree>
+std::vector<std::pair<int, int>> entries_of(const Tree& tree)
+{
+  std::vector<std::pair<int, int>> res;
+  tree.for_each_in_range(INT_MIN, INT_MAX, [&](int k, int v) {
+    res.emplace_back(k, v);
+  });
+  return res;
+}
+
+template <typename Tree>
+void fill_random(Tree& tree, std::set<int>& ref, size_t n, int range, std::mt19937& gen)
+{
+  std::uniform_int_distribution<int> dist(0, range);
+  for (size_t i = 0; i < n; i++) {
+    auto k = dist(gen);
+    tree.insert(std::make_pair(k, k));
+    ref.insert(k);
+  }
+}
+
+void test_bulk_build_join_split()
+{
+  std::cout << "Start test_bulk_build_join_split=====" << std::endl;
+  std::vector<std::pair<int, int>> items;
+  for (int i = 0; i < 10000; i++) items.emplace_back(2 * i, i);
+
+  OrderStatisticTree<int, int> tree;
+  tree.build_from_sorted(items.begin(), items.end());
+  check_avl(tree);
+  assert (tree.size() == items.size());
+  assert (tree.find(1998) && *tree.find(1998) == 999);
+  assert (tree.select(500)->first == 1000);
+
+  OrderStatisticTree<int, int> upper;
+  tree.split(5001, upper);
+  check_avl(tree);
+  check_avl(upper);
+  assert (tree.size() == 2501 && upper.size() == 7499);
+  assert (tree.rank(5001) == 2501 && upper.select(0)->first == 5002);
+
+  // Join trees of very different heights
+  OrderStatisticTree<int, int> tail;
+  for (int i = 0; i < 10; i++) tail.insert(std::make_pair(100000 + i, i));
+  upper.join(tail);
+  check_avl(upper);
+  assert (tail.size() == 0 && upper.size() == 7509);
+  tree.join(upper);
+  check_avl(tree);
+  assert (tree.size() == 10010);
+  assert (tree.select(10009)->first == 100009);
+  assert (tree.count_range(0, 20000) == 10000);
+
+  std::cout << "=====End test_bulk_build_join_split" << std::endl;
+}
+
+void test_insert_batch()
+{
+  std::cout << "Start test_insert_batch=====" << std::endl;
+  std::mt19937 gen(29);
+  OrderStatisticTree<int, int> tree;
+  std::map<int, int> ref;
+
+  // Batches from tiny to larger than the tree, into an empty tree first
+  for (size_t batch_size : {1000, 1, 2, 17, 300, 5000, 20000}) {
+    std::uniform_int_distribution<int> dist(0, 60000);
+    std::vector<std::pair<int, int>> batch;
+    for (size_t i = 0; i < batch_size; i++) {
+      int k = dist(gen);
+      batch.emplace_back(k, static_cast<int>(i));
+    }
+    size_t expected = 0;
+    for (auto& e : batch) expected += ref.insert(e).second;
+
+    assert (tree.insert_batch(batch.begin(), batch.end()) == expected);
+    check_avl(tree);
+    assert (tree.size() == ref.size());
+    std::vector<std::pair<int, int>> expected_entries(ref.begin(), ref.end());
+    assert (entries_of(tree) == expected_entries);
+    assert (tree.rank(30000) == (size_t)std::distance(ref.begin(), ref.lower_bound(30000)));
+  }
+
+  std::vector<std::pair<int, int>> empty;
+  assert (tree.insert_batch(empty.begin(), empty.end()) == 0);
+  std::cout << "=====End test_insert_batch" << std::endl;
+}
+
+void test_set_operations()
+{
+  std::cout << "Start test_set_operations=====" << std::endl;
+  ThreadPool tp(4);
+  std::mt19937 gen(3);
+
+  for (ThreadPool* pool : {(ThreadPool*)nullptr, &tp}) {
+    for (int op = 0; op < 3; op++) {
+      OrderStatisticTree<int, int> a, b;
+      std::set<int> ra, rb, expected;
+      fill_random(a, ra, 40000, 100000, gen);
+      fill_random(b, rb, 30000, 100000, gen);
+
+      if (op == 0) {
+        std::set_union(ra.begin(), ra.end(), rb.begin(), rb.end(),
+                       std::inserter(expected, expected.end()));
+        a.set_union(b, pool);
+      } else if (op == 1) {
+        std::set_intersection(ra.begin(), ra.end(), rb.begin(), rb.end(),
+                              std::inserter(expected, expected.end()));
+        a.set_intersection(b, pool);
+      } else {
+        std::set_difference(ra.begin(), ra.end(), rb.begin(), rb.end(),
+                            std::inserter(expected, expected.end()));
+        a.set_difference(b, pool);
+      }
+      check_avl(a);
+      assert (b.size() == 0);
+      assert (keys_of(a) == std::vector<int>(expected.begin(), expected.end()));
+      assert (a.rank(50000) == (size_t)std::distance(expected.begin(),
+                                                      expected.lower_bound(50000)));
+
+      // Nodes of `b` now live in the pool of `a`
+      for (int k = 0; k < 1000; k++) a.insert(std::make_pair(200000 + k, k));
+      check_avl(a);
+    }
+  }
+
+  std::cout << "=====End test_set_operations" << std::endl;
+}
+
+// Join and the set operations hand nodes over to another pool, so
+// values with destructors must not be destroyed on the way
+void test_string_values()
+{
+  std::cout << "Start test_string_values=====" << std::endl;
+  ThreadPool tp(4);
+  // Longer than the small string buffer, so every value owns memory
+  auto value = [](int k) { return "value number " + std::to_string(k) + " of the tree"; };
+  auto contents = [](const AVLTree_Base<int, std::string>& tree) {
+    std::map<int, std::string> res;
+    tree.for_each_in_range(INT_MIN, INT_MAX, [&](int k, const std::string& v) { res[k] = v; });
+    return res;
+  };
+
+  AVLTree_Base<int, std::string> low, high;
+  std::map<int, std::string> ref;
+  for (int k = 0; k < 500; k++) {
+    low.insert(std::make_pair(k, value(k)));
+    high.insert(std::make_pair(1000 + k, value(1000 + k)));
+    ref[k] = value(k);
+    ref[1000 + k] = value(1000 + k);
+  }
+  low.join(high);
+  assert (high.size() == 0 && low.size() == 1000);
+  assert (contents(low) == ref);
+
+  for (ThreadPool* pool : {(ThreadPool*)nullptr, &tp}) {
+    for (int op = 0; op < 3; op++) {
+      AVLTree_Base<int, std::string> a, b;
+      std::map<int, std::string> expected;
+      for (int k = 0; k < 3000; k += 2) a.insert(std::make_pair(k, value(k)));
+      for (int k = 0; k < 3000; k += 3) b.insert(std::make_pair(k, value(-k)));
+      for (int k = 0; k < 3000; k++) {
+        bool in_a = k % 2 == 0, in_b = k % 3 == 0;
+        if (op == 0 && (in_a || in_b)) expected[k] = value(in_a ? k : -k);
+        if (op == 1 && in_a && in_b) expected[k] = value(k);
+        if (op == 2 && in_a && !in_b) expected[k] = value(k);
+      }
+      if (op == 0) a.set_union(b, pool);
+      else if (op == 1) a.set_intersection(b, pool);
+      else a.set_difference(b, pool);
+      assert (b.size() == 0 && a.size() == expected.size());
+      assert (contents(a) == expected);
+      a.insert(std::make_pair(5000, value(5000)));
+      assert (a.find(5000) && *a.find(5000) == value(5000));
+    }
+  }
+
+  std::cout << "=====End test_string_values" << std::endl;
+}
+
+void test_interval_tree()
+{
+  std::cout << "Start test_interval_tree=====" << std::endl;
+  using Interval = std::pair<int, int>;
+  std::mt19937 gen(23);
+  std::uniform_int_distribution<int> start(0, 10000);
+  std::uniform_int_distribution<int> len(1, 300);
+
+  IntervalTree<int, int> tree;
+  std::map<Interval, int> ref;
+  for (int i = 0; i < 20000; i++) {
+    int s = start(gen);
+    Interval iv(s, s + len(gen));
+    if (i % 4 == 3 && !ref.empty()) {
+      // Erase an existing interval near s
+      auto it = ref.lower_bound(iv);
+      if (it == ref.end()) --it;
+      assert (tree.erase(it->first));
+      ref.erase(it);
+    } else if (ref.emplace(iv, i).second) {
+      assert (tree.insert(std::make_pair(iv, i)));
+    }
+  }
+  check_avl(tree);
+
+  auto check_query = [&](const IntervalTree<int, int>& t,
+                         const std::map<Interval, int>& r, int lo, int hi) {
+    std::vector<std::pair<Interval, int>> got, expected;
+    t.overlapping(lo, hi, [&](const Interval& iv, int v) { got.emplace_back(iv, v); });
+    for (auto& e : r) {
+      if (e.first.first < hi && lo < e.first.second) expected.push_back(e);
+    }
+    assert (got == expected);
+  };
+  for (int q = 0; q < 500; q++) {
+    int lo = start(gen);
+    // Point queries as well as ranges
+    check_query(tree, ref, lo, lo + (q % 2 ? 1 : len(gen)));
+  }
+  check_query(tree, ref, -10, 0);
+  check_query(tree, ref, 20000, 20001);
+
+  // Max ends stay current through bulk build and split/join
+  IntervalTree<int, int> built, upper;
+  built.build_from_sorted(ref.begin(), ref.end());
+  check_query(built, ref, 4000, 4100);
+  built.split(Interval(5000, 0), upper);
+  std::map<Interval, int> lower_ref(ref.begin(), ref.lower_bound(Interval(5000, 0)));
+  std::map<Interval, int> upper_ref(ref.lower_bound(Interval(5000, 0)), ref.end());
+  check_query(built, lower_ref, 4900, 5100);
+  check_query(upper, upper_ref, 4900, 5100);
+  built.join(upper);
+  check_query(built, ref, 4900, 5100);
+  std::cout << "=====End test_interval_tree" << std::endl;
+}
+
+void test_freeze()
+{
+  std::cout << "Start test_freeze=====" << std::endl;
+  std::mt19937 gen(17);
+  for (size_t n : {0, 1, 2, 3, 7, 8, 9, 100, 1000, 40000}) {
+    AVLTree_Base<int, int> tree;
+    std::map<int, int> ref;
+    std::uniform_int_distribution<int> dist(0, 4 * n + 4);
+    while (ref.size() < n) {
+      int k = dist(gen);
+      if (ref.emplace(k, -k).second) tree.insert(std::make_pair(k, -k));
+    }
+
+    auto frozen = tree.freeze();
+    assert (frozen.size() == n);
+    std::vector<std::pair<int, int>> entries;
+    for (auto it = frozen.begin(); it != frozen.end(); ++it) {
+      entries.emplace_back(it.key(), it.value());
+    }
+    std::vector<std::pair<int, int>> expected(ref.begin(), ref.end());
+    assert (entries == expected);
+
+    for (int k = -1; k <= (int)(4 * n + 5); k++) {
+      auto v = frozen.find(k);
+      auto it = ref.find(k);
+      assert ((v == nullptr) == (it == ref.end()));
+      assert (!v || *v == -k);
+
+      auto lb = frozen.lower_bound(k);
+      auto rlb = ref.lower_bound(k);
+      assert ((lb == frozen.end()) == (rlb == ref.end()));
+      assert (lb == frozen.end() || lb.key() == rlb->first);
+    }
+
+    size_t count = 0;
+    frozen.for_each_in_range(n, 3 * n, [&](int k, int v) {
+      assert (k >= (int)n && k < (int)(3 * n) && v == -k);
+      count++;
+    });
+    assert (count == (size_t)std::distance(ref.lower_bound(n), ref.lower_bound(3 * n)));
+  }
+  std::cout << "=====End test_freeze" << std::endl;
+}
+
+void test_concurrent_avl_tree()
+{
+  std::cout << "Start test_concurrent_avl_tree=====" << std::endl;
+  {
+    ConcurrentAVLTree<int, int> map;
+    std::map<int, int> ref;
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int> dist(0, 20000);
+
+    for (int i = 0; i < 100000; i++) {
+      int k = dist(gen);
+      int op = i % 4;
+      if (op == 0 || op == 1) {
+        assert (map.insert(std::make_pair(k, i)) == ref.emplace(k, i).second);
+      } else if (op == 2) {
+        bool absent = ref.find(k) == ref.end();
+        ref[k] = i;
+        assert (map.insert_or_assign(std::make_pair(k, i)) == absent);
+      } else {
+        assert (map.erase(k) == (ref.erase(k) == 1));
+      }
+    }
+    assert (map.size() == ref.size());
+    for (int k = 0; k <= 20000; k++) {
+      int v = -1;
+      auto it = ref.find(k);
+      assert (map.find(k, v) == (it != ref.end()));
+      assert (it == ref.end() || it->second == v);
+    }
+    // Routing nodes aside, the tree is balanced when quiescent
+    assert (map.height() <= 2 * 15);
+    // Unlinked nodes are freed as the epochs advance
+    assert (map.retired_nodes() < 1000);
+  }
+
+  {
+    // Each thread owns the keys congruent to its id, so the
+    // final state is known while the updates interleave
+    const int nthreads = 4;
+    const int nkeys = 40000;
+    ConcurrentAVLTree<int, int> map;
+    std::atomic<bool> done{false};
+    std::vector<std::thread> writers;
+
+    std::thread reader([&] {
+      int v;
+      while (!done.load()) {
+        for (int k = 0; k < nkeys; k += 97) {
+          if (map.find(k, v)) assert (v == k);
+        }
+      }
+    });
+    for (int t = 0; t < nthreads; t++) {
+      writers.emplace_back([&map, t, nthreads, nkeys] {
+        for (int k = t; k < nkeys; k += nthreads) {
+          assert (map.insert(std::make_pair(k, k)));
+        }
+        for (int k = t; k < nkeys; k += 2 * nthreads) {
+          assert (map.erase(k));
+        }
+      });
+    }
+    for (auto& w : writers) w.join();
+    done.store(true);
+    reader.join();
+
+    assert (map.size() == nkeys / 2);
+    // Once quiescent, a few updates let the epochs catch up with the
+    // retire lists the writers left behind
+    for (int i = 0; i < 4 * 64; i++) {
+      map.insert(std::make_pair(nkeys + i, 0));
+      map.erase(nkeys + i);
+    }
+    assert (map.retired_nodes() < 1000);
+    for (int k = 0; k < nkeys; k++) {
+      int v = -1;
+      bool erased = (k % nthreads) == (k % (2 * nthreads));
+      assert (map.find(k, v) == !erased);
+      assert (erased || v == k);
+    }
+  }
+  std::cout << "=====End test_concurrent_avl_tree" << std::endl;
+}
+
+void test_persistent_avl_tree()
+{
+  std::cout << "Start test_persistent_avl_tree=====" << std::endl;
+  {
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<int> dist(0, 5000);
+    PersistentAVLTree<int, int> tree;
+    std::map<int, int> ref;
+    // Every 1000th version with its expected contents
+    std::vector<std::pair<PersistentAVLTree<int, int>, std::map<int, int>>> versions;
+
+    for (int i = 0; i < 20000; i++) {
+      int k = dist(gen);
+      if (i % 3 == 2) {
+        tree = tree.erase(k);
+        ref.erase(k);
+      } else {
+        tree = tree.insert(std::make_pair(k, i));
+        ref.emplace(k, i);
+      }
+      if (i % 1000 == 0) versions.emplace_back(tree, ref);
+    }
+    assert (tree.size() == ref.size());
+    // AVL bound for ~3000 keys
+    assert (tree.height() <= 17);
+
+    for (auto& ver : versions) {
+      std::vector<std::pair<int, int>> expected(ver.second.begin(), ver.second.end());
+      assert (ver.first.size() == expected.size());
+      assert (entries_of(ver.first) == expected);
+    }
+    for (int k = 0; k <= 5000; k++) {
+      auto v = tree.find(k);
+      auto it = ref.find(k);
+      assert ((v == nullptr) == (it == ref.end()));
+      assert (!v || *v == it->second);
+    }
+  }
+
+  {
+    // Snapshots taken during writes must always be consistent
+    SnapshotAVLMap<int, int> map;
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+      while (!done.load()) {
+        auto snap = map.snapshot();
+        auto entries = entries_of(*snap);
+        assert (entries.size() == snap->size());
+        for (size_t i = 0; i < entries.size(); i++) {
+          assert (entries[i].first == entries[i].second);
+          assert (i == 0 || entries[i - 1].first < entries[i].first);
+        }
+      }
+    });
+    for (int k = 0; k < 5000; k++) assert (map.insert(std::make_pair(k, k)));
+    for (int k = 0; k < 5000; k += 2) assert (map.erase(k));
+    assert (!map.erase(0));
+    done.store(true);
+    reader.join();
+    assert (map.snapshot()->size() == 2500);
+  }
+  std::cout << "=====End test_persistent_avl_tree" << std::endl;
+}
+
+void test_btree_map()
+{
+  std::cout << "Start test_btree_map=====" << std::endl;
+  BTreeMap<int, int> bmap;
+  std::map<int, int> ref;
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(-100000, 100000);
+
+  for (int i = 0; i < 50000; i++) {
+    auto k = dist(gen);
+    bool inserted = ref.emplace(k, i).second;
+    assert (bmap.insert(std::make_pair(k, i)) == inserted);
+  }
+  assert (bmap.size() == ref.size());
+
+  for (int i = -100000; i <= 100000; i += 7) {
+    auto it = ref.find(i);
+    auto v = bmap.find(i);
+    assert ((it == ref.end()) == (v == nullptr));
+    if (v) assert (*v == it->second);
+  }
+
+  std::vector<int> keys;
+  bmap.for_each_in_range(-500, 500, [&keys](int k, int) { keys.push_back(k); });
+  auto first = ref.lower_bound(-500), last = ref.lower_bound(500);
+  assert (keys.size() == (size_t)std::distance(first, last));
+  assert (std::equal(keys.begin(), keys.end(), first,
+                     [](int k, const std::pair<const int, int>& e) { return k == e.first; }));
+
+  BTreeMap<std::string, int> smap;
+  for (int i = 0; i < 1000; i++) {
+    assert (smap.insert(std::make_pair(std::to_string(i), i)));
+  }
+  assert (!smap.insert(std::make_pair(std::string("10"), 10)));
+  assert (smap.find("999") && *smap.find("999") == 999);
+  assert (smap.find("1000") == nullptr);
+
+  std::cout << "=====End test_btree_map" << std::endl;
+}
+
 int main() {
   test_simple();
+  test_node_layout();
+  test_insert_erase();
+  test_order_statistic();
+  test_bulk_build_join_split();
+  test_insert_batch();
+  test_set_operations();
+  test_string_values();
+  test_interval_tree();
+  test_freeze();
+  test_concurrent_avl_tree();
+  test_persistent_avl_tree();
+  test_btree_map();
   return 0;
 }
@@ -0,0 +1,197 @@
+// Build: g++ -std=c++11 -O2 -DNDEBUG -pthread bench.cc -o bench
+// Usage: ./bench [num_elements] [edge_file]
+//        edge_file as read by load_edge_file (kruskal.hpp), else a
+//        random graph with 4 * num_elements edges is written and used
+#include "disjoint_set.hpp"
+#include "concurrent_disjoint_set.hpp"
+#include "kruskal.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace ds;
+
+namespace {
+
+template <typename F>
+double time_ns(F&& f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+using Unions = std::vector<std::pair<int, int>>;
+
+/*
+ * Union sequences over 0..n-1:
+ * random   - uniformly random pairs, n of them.
+ * chain    - (i, i+1): without balancing this is a linked list.
+ * binomial - rounds of (i, i + s) for s = 1, 2, 4, ..., merging
+ *            equal rank trees only, which drives ranks to log2 n.
+ */
+Unions make_unions(const std::string& kind, int n, std::mt19937& gen)
+{
+  Unions unions;
+  if (kind == "random") {
+    std::uniform_int_distribution<int> dist(0, n - 1);
+    for (int i = 0; i < n; i++) unions.emplace_back(dist(gen), dist(gen));
+  } else if (kind == "chain") {
+    for (int i = 0; i + 1 < n; i++) unions.emplace_back(i, i + 1);
+  } else if (kind == "binomial") {
+    for (int s = 1; s < n; s *= 2) {
+      for (int i = 0; i + s < n; i += 2 * s) unions.emplace_back(i, i + s);
+    }
+  }
+  return unions;
+}
+
+void bench(const std::string& kind, int n, std::mt19937& gen)
+{
+  auto unions = make_unions(kind, n, gen);
+  std::uniform_int_distribution<int> dist(0, n - 1);
+  std::vector<int> probes(n);
+  for (auto& p : probes) p = dist(gen);
+
+  DisjointSet<int> djs;
+  double make_ns = time_ns([&] {
+    for (int i = 0; i < n; i++) djs.make_set(i);
+  });
+  double union_ns = time_ns([&] {
+    for (auto& u : unions) djs.union_set(u.first, u.second);
+  });
+  long check = 0;
+  double find_ns = time_ns([&] {
+    for (auto p : probes) check += djs.find_set(p);
+  });
+
+  std::cout << kind << "\tDisjointSet\t" << n
+            << "\t" << make_ns / n
+            << "\t" << union_ns / unions.size()
+            << "\t" << find_ns / n
+            << "\t(sets " << djs.sets() << ", check " << check << ")" << std::endl;
+
+  // Same unions on the dense ids directly
+  std::unique_ptr<DenseDisjointSet> dense;
+  make_ns = time_ns([&] { dense.reset(new DenseDisjointSet(n)); });
+  union_ns = time_ns([&] {
+    for (auto& u : unions) dense->union_set(u.first, u.second);
+  });
+  check = 0;
+  find_ns = time_ns([&] {
+    for (auto p : probes) check += dense->find_set(p);
+  });
+
+  std::cout << kind << "\tDense\t" << n
+            << "\t" << make_ns / n
+            << "\t" << union_ns / unions.size()
+            << "\t" << find_ns / n
+            << "\t(sets " << dense->sets() << ", check " << check << ")" << std::endl;
+}
+
+// Connected components of a random graph with 2n edges:
+// union_edges over growing thread counts against DenseDisjointSet
+void bench_concurrent(int n, std::mt19937& gen)
+{
+  std::uniform_int_distribution<uint32_t> dist(0, n - 1);
+  std::vector<std::pair<uint32_t, uint32_t>> edges(2 * static_cast<size_t>(n));
+  for (auto& e : edges) e = std::make_pair(dist(gen), dist(gen));
+
+  std::cout << "\ncomponents of " << n << " vertices, " << edges.size() << " edges" << std::endl;
+  DenseDisjointSet seq(n);
+  double ns = time_ns([&] {
+    for (auto& e : edges) seq.union_set(e.first, e.second);
+  });
+  std::cout << "Dense\t1\t" << ns / edges.size() << " ns/edge\t(sets "
+            << seq.sets() << ")" << std::endl;
+
+  size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+  for (size_t nt = 1; nt <= max_threads; nt *= 2) {
+    ThreadPool tp(nt);
+    ConcurrentDisjointSet conc(n);
+    ns = time_ns([&] { conc.union_edges(edges.begin(), edges.end(), tp); });
+    std::cout << "Concurrent\t" << nt << "\t" << ns / edges.size()
+              << " ns/edge\t(sets " << conc.sets() << ")" << std::endl;
+  }
+}
+
+// Kruskal pipeline stage by stage: mapping + parsing the edge file,
+// radix sort against std::sort, the MST scan and component labels
+void bench_kruskal(int n, std::mt19937& gen, std::string path)
+{
+  bool generated = path.empty();
+  if (generated) {
+    path = "kruskal_bench_edges.bin";
+    std::uniform_int_distribution<uint32_t> vdist(0, n - 1);
+    std::uniform_real_distribution<float> wdist(0, 1000);
+    std::vector<Edge> edges(4 * static_cast<size_t>(n));
+    for (auto& e : edges) e = Edge{vdist(gen), vdist(gen), wdist(gen)};
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(edges.data()), edges.size() * sizeof(Edge));
+  }
+
+  std::cout << "\nkruskal on " << path << std::endl;
+  std::cout << "threads\tload GB/s\tradix ns/edge\tstd::sort ns/edge\tkruskal ns/edge"
+            << "\tlabels ns/edge" << std::endl;
+  size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+  for (size_t nt = 1; nt <= max_threads; nt *= 2) {
+    ThreadPool tp(nt);
+    std::vector<Edge> edges;
+    size_t bytes = 0;
+    double load_ns = time_ns([&] {
+      MappedFile file(path);
+      bytes = file.size();
+      edges = path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0
+                ? parse_edges_binary(file.data(), file.size(), tp)
+                : parse_edges_text(file.data(), file.size(), tp);
+    });
+    size_t nv = vertex_count(edges, tp);
+    size_t m = std::max<size_t>(1, edges.size());
+
+    auto copy = edges;
+    double std_ns = time_ns([&] {
+      std::sort(copy.begin(), copy.end(), [](const Edge& a, const Edge& b) { return a.w < b.w; });
+    });
+    double radix_ns = time_ns([&] { radix_sort_by_weight(edges, tp); });
+
+    SpanningForest forest;
+    double mst_ns = time_ns([&] { forest = kruskal(edges, nv); });
+    std::vector<uint32_t> labels;
+    double label_ns = time_ns([&] { labels = component_labels(edges, nv, tp); });
+
+    std::cout << nt << "\t" << bytes / load_ns
+              << "\t" << radix_ns / m
+              << "\t" << std_ns / m
+              << "\t" << mst_ns / m
+              << "\t" << label_ns / m
+              << "\t(" << nv << " vertices, " << edges.size() << " edges, forest weight "
+              << forest.weight << ", " << forest.components << " components)" << std::endl;
+  }
+  if (generated) std::remove(path.c_str());
+}
+
+} // end anon namespace
+
+int main(int argc, char* argv[])
+{
+  int n = argc > 1 ? std::atoi(argv[1]) : 4000000;
+  std::mt19937 gen(1234);
+
+  std::cout << "unions\tstructure\telements\tmake_set ns\tunion_set ns\tfind_set ns" << std::endl;
+  for (int size = 1000000; size <= n; size *= 2) {
+    for (auto kind : {"random", "chain", "binomial"}) bench(kind, size, gen);
+  }
+  bench_concurrent(n, gen);
+  bench_kruskal(n, gen, argc > 2 ? argv[2] : "");
+  return 0;
+}
@@ -0,0 +1,148 @@
+#ifndef CONCURRENT_DISJOINT_SET_HPP
+#define CONCURRENT_DISJOINT_SET_HPP
+
+#if __cplusplus < 201103L
+#error This header needs atleast a C++11 compliant compiler.
+#endif
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include "../util/thread_pool.hpp"
+
+namespace ds {
+
+/*
+ * @class ConcurrentDisjointSet
+ * Lock free union-find over the dense ids 0..n-1, safe to use
+ * from any number of threads (after Jayanti and Tarjan,
+ * "Concurrent Disjoint Set Union").
+ *
+ * - Linking is a single CAS of a root's parent. Roots are linked
+ *   by a fixed random priority (a bijective hash of the id) rather
+ *   than by rank, which needs no extra shared state and gives the
+ *   same expected O(log n) tree height.
+ * - find does path splitting: every node on the way is CAS'ed to
+ *   its grandparent. A failed CAS only means someone else already
+ *   shortened the path, so it is not retried.
+ *
+ * Exposed API's:
+ * 1. union_set(a, b)   - Merges the sets of a and b; false if they
+ *                        were the same set already.
+ * 2. find_set(a)       - Current representative of the set of a.
+ *                        Only stable once the unions are done.
+ * 3. same_set(a, b)    - Linearizable, also during unions.
+ * 4. union_edges(first, last, nthreads) - union_set of every
+ *                        (.first, .second) pair in the random access
+ *                        range, split over nthreads threads.
+ * 5. size(), sets()
+ */
+class ConcurrentDisjointSet
+{
+public:
+  using id_type = uint32_t;
+
+public:
+  // n singleton sets 0..n-1
+  explicit ConcurrentDisjointSet(size_t n):
+    parent_(new std::atomic<id_type>[n]),
+    size_(n),
+    sets_(n)
+  {
+    assert (n <= UINT32_MAX);
+    for (size_t i = 0; i < n; i++) {
+      parent_[i].store(static_cast<id_type>(i), std::memory_order_relaxed);
+    }
+  }
+
+  ConcurrentDisjointSet(const ConcurrentDisjointSet&) = delete;
+  void operator=(const ConcurrentDisjointSet&) = delete;
+
+public:
+  size_t size() const noexcept { return size_; }
+  size_t sets() const noexcept { return sets_.load(std::memory_order_relaxed); }
+
+  id_type find_set(id_type idx) noexcept {
+    assert (idx < size_);
+    while (true) {
+      id_type parent = parent_[idx].load(std::memory_order_acquire);
+      if (parent == idx) return idx;
+      id_type grand = parent_[parent].load(std::memory_order_acquire);
+      if (grand != parent) {
+        parent_[idx].compare_exchange_weak(parent, grand, std::memory_order_acq_rel,
+                                           std::memory_order_relaxed);
+      }
+      idx = parent;
+    }
+  }
+
+  bool same_set(id_type a, id_type b) noexcept {
+    while (true) {
+      a = find_set(a);
+      b = find_set(b);
+      if (a == b) return true;
+      // a still being a root means a and b were apart when b was found
+      if (parent_[a].load(std::memory_order_acquire) == a) return false;
+    }
+  }
+
+  bool union_set(id_type a, id_type b) noexcept {
+    while (true) {
+      a = find_set(a);
+      b = find_set(b);
+      if (a == b) return false;
+
+      // Lower priority root goes under the higher one
+      if (priority(a) > priority(b)) std::swap(a, b);
+      id_type expected = a;
+      if (parent_[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel,
+                                             std::memory_order_relaxed)) {
+        sets_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+      // a got linked meanwhile, retry from its new root
+    }
+  }
+
+  // Returns the number of unions that merged two sets
+  template <typename Iter>
+  size_t union_edges(Iter first, Iter last, ThreadPool& tp) {
+    std::atomic<size_t> merged{0};
+    tp.parallel_for(0, std::distance(first, last), [&](size_t b, size_t e) {
+      size_t local = 0;
+      for (auto it = first + b; it != first + e; ++it) {
+        local += union_set(it->first, it->second);
+      }
+      merged.fetch_add(local, std::memory_order_relaxed);
+    });
+    return merged.load();
+  }
+
+  template <typename Iter>
+  size_t union_edges(Iter first, Iter last, size_t nthreads) {
+    ThreadPool tp(nthreads);
+    return union_edges(first, last, tp);
+  }
+
+private:
+  // Bijective mix (murmur3 finalizer), distinct ids never tie
+  static id_type priority(id_type x) noexcept {
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35u;
+    x ^= x >> 16;
+    return x;
+  }
+
+private:
+  std::unique_ptr<std::atomic<id_type>[]> parent_;
+  size_t size_;
+  std::atomic<size_t> sets_;
+};
+
+}
+#endif
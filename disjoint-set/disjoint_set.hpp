@@ -5,20 +5,244 @@
 #error This header needs atleast a C++11 compliant compiler.
 #endif
 
+#include <algorithm>
 #include <cassert>
-#include <memory>
+#include <cstdint>
+#include <ostream>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace ds {
 
-struct ListNode {
-  ListNode(): parent_(this) {}
-  int id_ = 0;
-  int children_ = 0;
-  ListNode* parent_ = nullptr;
-  ListNode* next_ = nullptr;
+/*
+ * @class DenseDisjointSet
+ * Union-find over the dense ids 0..n-1, e.g graph vertices.
+ * The forest lives in flat 32 bit arrays, no hashing and no per
+ * element allocation.
+ * Union by size bounds the trees at O(log n) height, path
+ * halving on every find flattens them further, together giving
+ * near constant (inverse Ackermann) amortised operations.
+ * The size of a root doubles as the size of its set, and the
+ * members of every set are chained in a circular list through
+ * next_: two circles become one by swapping the successors of
+ * any member of each, so a union splices them in O(1).
+ *
+ * Exposed API's:
+ * 1. add()             - New singleton set, returns its id.
+ * 2. union_set(a, b)   - Merges the sets of a and b; false if they
+ *                        were the same set already.
+ * 3. find_set(a)       - Representative id of the set of a.
+ * 4. same_set(a, b)
+ * 5. set_size(a)       - Number of elements in the set of a.
+ * 6. for_each_member(a, f) - Calls f(id) for every element of the
+ *                        set of a, O(set_size(a)).
+ * 7. size(), sets()    - Number of elements and of disjoint sets.
+ */
+class DenseDisjointSet
+{
+public:
+  using id_type = uint32_t;
+
+public:
+  // n singleton sets 0..n-1
+  explicit DenseDisjointSet(size_t n = 0):
+    parent_(n),
+    size_(n, 1),
+    next_(n),
+    sets_(n)
+  {
+    assert (n <= UINT32_MAX);
+    for (size_t i = 0; i < n; i++) {
+      parent_[i] = next_[i] = static_cast<id_type>(i);
+    }
+  }
+
+  DenseDisjointSet(const DenseDisjointSet&) = delete;
+  void operator=(const DenseDisjointSet&) = delete;
+
+public:
+  size_t size() const noexcept { return parent_.size(); }
+  size_t sets() const noexcept { return sets_; }
+
+  // Strong guarantee: nothing changes if growing an array throws
+  id_type add() {
+    auto id = static_cast<id_type>(parent_.size());
+    assert (parent_.size() < UINT32_MAX);
+    reserve_for_one(parent_);
+    reserve_for_one(size_);
+    reserve_for_one(next_);
+    parent_.push_back(id);
+    size_.push_back(1);
+    next_.push_back(id);
+    sets_++;
+    return id;
+  }
+
+  // Path halving: every node on the way points to its grandparent
+  id_type find_set(id_type idx) noexcept {
+    assert (idx < parent_.size());
+    while (parent_[idx] != idx) {
+      parent_[idx] = parent_[parent_[idx]];
+      idx = parent_[idx];
+    }
+    return idx;
+  }
+
+  bool same_set(id_type a, id_type b) noexcept {
+    return find_set(a) == find_set(b);
+  }
+
+  bool union_set(id_type a, id_type b) noexcept {
+    id_type root1 = find_set(a);
+    id_type root2 = find_set(b);
+    if (root1 == root2) return false;
+
+    // The smaller tree goes under the larger one
+    if (size_[root1] < size_[root2]) std::swap(root1, root2);
+    parent_[root2] = root1;
+    size_[root1] += size_[root2];
+    std::swap(next_[root1], next_[root2]);
+    sets_--;
+    return true;
+  }
+
+  size_t set_size(id_type idx) noexcept {
+    return size_[find_set(idx)];
+  }
+
+  template <typename F>
+  void for_each_member(id_type idx, F&& f) const {
+    assert (idx < parent_.size());
+    id_type member = idx;
+    do {
+      f(member);
+      member = next_[member];
+    } while (member != idx);
+  }
+
+private:
+  // Geometric growth, as push_back would do, but ahead of time
+  static void reserve_for_one(std::vector<id_type>& v) {
+    if (v.size() == v.capacity()) v.reserve(std::max<size_t>(16, 2 * v.capacity()));
+  }
+
+private:
+  std::vector<id_type> parent_;
+  // Only meaningful for roots
+  std::vector<id_type> size_;
+  // Circular list of the members of each set
+  std::vector<id_type> next_;
+  size_t sets_ = 0;
 };
 
+/*
+ * @class RollbackDisjointSet
+ * Union-find over the dense ids 0..n-1 whose unions can be undone,
+ * e.g for offline dynamic connectivity or backtracking search.
+ * Union by rank but no path compression, so a union changes only
+ * the parent (and maybe the rank) of one root and is recorded in
+ * an undo log. find_set is O(log n).
+ *
+ * Exposed API's:
+ * 1. union_set(a, b)  - Merges the sets of a and b; false if they
+ *                       were the same set already (nothing logged).
+ * 2. find_set(a), same_set(a, b), size(), sets()
+ * 3. snapshot()       - Marker of the current state.
+ * 4. rollback(to)     - Undoes every union made after snapshot
+ *                       `to`, O(number of undone unions).
+ */
+class RollbackDisjointSet
+{
+public:
+  using id_type = uint32_t;
+  using snapshot_type = size_t;
+
+public:
+  // n singleton sets 0..n-1
+  explicit RollbackDisjointSet(size_t n = 0):
+    parent_(n),
+    rank_(n, 0),
+    sets_(n)
+  {
+    assert (n <= UINT32_MAX);
+    for (size_t i = 0; i < n; i++) parent_[i] = static_cast<id_type>(i);
+  }
+
+  RollbackDisjointSet(const RollbackDisjointSet&) = delete;
+  void operator=(const RollbackDisjointSet&) = delete;
+
+public:
+  size_t size() const noexcept { return parent_.size(); }
+  size_t sets() const noexcept { return sets_; }
+
+  id_type find_set(id_type idx) const noexcept {
+    assert (idx < parent_.size());
+    while (parent_[idx] != idx) idx = parent_[idx];
+    return idx;
+  }
+
+  bool same_set(id_type a, id_type b) const noexcept {
+    return find_set(a) == find_set(b);
+  }
+
+  bool union_set(id_type a, id_type b) {
+    id_type root1 = find_set(a);
+    id_type root2 = find_set(b);
+    if (root1 == root2) return false;
+
+    if (rank_[root1] < rank_[root2]) std::swap(root1, root2);
+    bool bumped = rank_[root1] == rank_[root2];
+    parent_[root2] = root1;
+    if (bumped) rank_[root1]++;
+    sets_--;
+    log_.push_back(UndoEntry{root2, bumped});
+    return true;
+  }
+
+  snapshot_type snapshot() const noexcept { return log_.size(); }
+
+  void rollback(snapshot_type to) noexcept {
+    assert (to <= log_.size());
+    while (log_.size() > to) {
+      const UndoEntry& e = log_.back();
+      id_type root = parent_[e.child_];
+      parent_[e.child_] = e.child_;
+      if (e.rank_bumped_) rank_[root]--;
+      sets_++;
+      log_.pop_back();
+    }
+  }
+
+private:
+  // The root that was linked under another one
+  struct UndoEntry {
+    id_type child_;
+    bool rank_bumped_;
+  };
+
+private:
+  std::vector<id_type> parent_;
+  std::vector<uint8_t> rank_;
+  std::vector<UndoEntry> log_;
+  size_t sets_ = 0;
+};
+
+/*
+ * @class DisjointSet
+ * Union-find over arbitrary values: make_set() interns each value
+ * into a dense id of a DenseDisjointSet, the only hashing done.
+ *
+ * Exposed API's:
+ * 1. make_set(val)         - Adds val as a singleton set.
+ * 2. union_set(val1, val2) - Merges the sets of val1 and val2.
+ * 3. find_set(val)         - Id of the set of val, equal for
+ *                            values of the same set.
+ * 4. set_size(val)         - Number of values in the set of val.
+ * 5. for_each_member(val, f) - Calls f(value) for every value in
+ *                            the set of val, O(set_size(val)).
+ * 6. sets()                - Number of disjoint sets.
+ */
 template <typename ValueType>
 class DisjointSet
 {
@@ -31,63 +255,64 @@ public:
 
 public:
   size_t sets() const noexcept {
-    return sets_;
+    return forest_.sets();
   }
 
   void make_set(const ValueType& val) {
-    std::unique_ptr<ListNode> tmp(new ListNode());
-    tmp->id_ = sets_;
-    tracker_.emplace(val, std::move(tmp));
-    sets_++;
+    auto res = tracker_.emplace(val, 0);
+    if (!res.second) return;
+    // Leaves val unknown if the forest or values_ cannot grow
+    try {
+      values_.push_back(&res.first->first);
+      try {
+        res.first->second = forest_.add();
+      } catch (...) {
+        values_.pop_back();
+        throw;
+      }
+    } catch (...) {
+      tracker_.erase(res.first);
+      throw;
+    }
   }
 
   void union_set(const ValueType& val1, const ValueType& val2) {
-    auto it1 = tracker_.find(val1);
-    assert (it1 != tracker_.end());
-
-    auto it2 = tracker_.find(val2);
-    assert (it2 != tracker_.end());
-
-    auto node1 = it1->second.get();
-    auto node2 = it2->second.get();
-    ListNode* master, *child;
-
-    if (node1->parent_->children_ <= node2->parent_->children_) {
-      master = node2->parent_; 
-      child = node1->parent_;
-    } else {
-      master = node1->parent_;
-      child = node2->parent_;
-    }
-
-    ListNode* second = child;
-    while (second) {
-      auto nxt = second->next_;
-      second->next_ = master->next_;
-      master->next_ = second;
-      master->children_++;
-      second->parent_ = master;
-      second = nxt;
-    }
-    sets_--;
+    forest_.union_set(id_of(val1), id_of(val2));
   }
 
   int find_set(const ValueType& val) {
-    auto it = tracker_.find(val);
-    assert (it != tracker_.end());
+    return static_cast<int>(forest_.find_set(id_of(val)));
+  }
+
+  size_t set_size(const ValueType& val) {
+    return forest_.set_size(id_of(val));
+  }
 
-    return it->second->parent_->id_;
+  template <typename F>
+  void for_each_member(const ValueType& val, F&& f) const {
+    forest_.for_each_member(id_of(val), [&](DenseDisjointSet::id_type id) {
+      f(*values_[id]);
+    });
   }
 
   void print_sets(std::ostream& os) {
     for (auto& e : tracker_) {
-      os << e.first << " = " << e.second->parent_->id_ << "\n";
+      os << e.first << " = " << forest_.find_set(e.second) << "\n";
     }
   }
 
 private:
-  std::unordered_map<ValueType, std::unique_ptr<ListNode>> tracker_;
-  size_t sets_ = 0;
+  DenseDisjointSet::id_type id_of(const ValueType& val) const {
+    auto it = tracker_.find(val);
+    assert (it != tracker_.end());
+    return it->second;
+  }
+
+private:
+  std::unordered_map<ValueType, DenseDisjointSet::id_type> tracker_;
+  // Id to value, pointing at the keys of tracker_ which never move
+  std::vector<const ValueType*> values_;
+  DenseDisjointSet forest_;
 };
 
 }
@@ -0,0 +1,373 @@
+#ifndef KRUSKAL_HPP
+#define KRUSKAL_HPP
+/*!
+ * Edge list ingestion and Kruskal minimum spanning forest.
+ *
+ * Pipeline:
+ * 1. MappedFile maps the edge file read only, with sequential
+ *    read ahead advice, so the kernel streams it in.
+ * 2. parse_edges splits the mapping into one chunk per task and
+ *    parses the chunks in parallel.
+ * 3. radix_sort_by_weight sorts by weight with a parallel LSD
+ *    radix sort (8 bit digits, per block histograms, stable).
+ * 4. kruskal scans the sorted edges once with DenseDisjointSet.
+ *    component_labels only needs connectivity and unions the
+ *    unsorted edges with ConcurrentDisjointSet instead.
+ *
+ * Edge files:
+ * - Binary: raw Edge records (uint32 u, uint32 v, float w; 12
+ *   bytes, host byte order). Selected by a ".bin" suffix.
+ * - Text: one "u v [w]" line per edge, w defaults to 1. Lines
+ *   starting with '#' or '%' are comments (SNAP, Matrix Market).
+ *   Any other line that is not two 32 bit ids and an optional
+ *   weight is malformed: it is dropped and counted, and
+ *   load_edge_file throws unless the caller asks for the count.
+ */
+
+#if __cplusplus < 201103L
+#error This header needs atleast a C++11 compliant compiler.
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "disjoint_set.hpp"
+#include "concurrent_disjoint_set.hpp"
+#include "../util/mapped_file.hpp"
+#include "../util/thread_pool.hpp"
+
+namespace ds {
+
+struct Edge {
+  uint32_t u;
+  uint32_t v;
+  float w;
+};
+
+static_assert (sizeof(Edge) == 12, "Edge is the binary record layout");
+
+namespace detail {
+
+inline const char* skip_blanks(const char* p, const char* end) noexcept {
+  while (p != end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+  return p;
+}
+
+// Returns the end of the digits, or nullptr if there are none or
+// the value does not fit in 32 bits
+inline const char* parse_uint(const char* p, const char* end, uint32_t& out) noexcept {
+  const char* first = p;
+  uint64_t val = 0;
+  while (p != end && *p >= '0' && *p <= '9') {
+    val = val * 10 + (*p++ - '0');
+    if (val > UINT32_MAX) return nullptr;
+  }
+  if (p == first) return nullptr;
+  out = static_cast<uint32_t>(val);
+  return p;
+}
+
+// [-]digits[.digits][e[-]digits], no locale and no NUL terminator
+// needed. Returns nullptr if the mantissa or the exponent has no
+// digits, or if the value does not fit in a float.
+inline const char* parse_float(const char* p, const char* end, float& out) noexcept {
+  bool neg = p != end && *p == '-';
+  if (neg || (p != end && *p == '+')) p++;
+  const char* first = p;
+  double val = 0;
+  while (p != end && *p >= '0' && *p <= '9') val = val * 10 + (*p++ - '0');
+  if (p != end && *p == '.') {
+    double scale = 0.1;
+    for (p++; p != end && *p >= '0' && *p <= '9'; p++, scale *= 0.1) val += (*p - '0') * scale;
+  }
+  if (p == first || (p == first + 1 && *first == '.')) return nullptr;
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool eneg = p != end && *p == '-';
+    if (eneg || (p != end && *p == '+')) p++;
+    const char* digits = p;
+    // Past 400 the double over or underflows anyway
+    int exp = 0;
+    for (; p != end && *p >= '0' && *p <= '9'; p++) exp = std::min(exp * 10 + (*p - '0'), 400);
+    if (p == digits) return nullptr;
+    val *= std::pow(10.0, eneg ? -exp : exp);
+  }
+  out = static_cast<float>(neg ? -val : val);
+  if (!std::isfinite(out)) return nullptr;
+  return p;
+}
+
+inline bool is_blank(const char* p, const char* end) noexcept {
+  return p != end && (*p == ' ' || *p == '\t' || *p == '\r');
+}
+
+// Parses the edge line [p, eol), false if it is malformed
+inline bool parse_edge_line(const char* p, const char* eol, Edge& e) noexcept {
+  p = parse_uint(p, eol, e.u);
+  if (!p || !is_blank(p, eol)) return false;
+  p = parse_uint(skip_blanks(p, eol), eol, e.v);
+  if (!p) return false;
+  const char* q = skip_blanks(p, eol);
+  if (q != eol) {
+    if (q == p || !(q = parse_float(q, eol, e.w))) return false;
+    q = skip_blanks(q, eol);
+  }
+  return q == eol;
+}
+
+// Parses the lines starting in [first, last) of a buffer ending at
+// end and returns the number of malformed lines skipped
+inline size_t parse_text_chunk(const char* first, const char* last, const char* end,
+                               std::vector<Edge>& out)
+{
+  size_t rejected = 0;
+  const char* p = first;
+  while (p < last) {
+    const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (!eol) eol = end;
+
+    const char* q = skip_blanks(p, eol);
+    if (q != eol && *q != '#' && *q != '%') {
+      Edge e{0, 0, 1.0f};
+      if (parse_edge_line(q, eol, e)) out.push_back(e);
+      else rejected++;
+    }
+    p = eol + 1;
+  }
+  return rejected;
+}
+
+// Order preserving map of a float to an unsigned key
+inline uint32_t weight_key(float w) noexcept {
+  uint32_t bits;
+  std::memcpy(&bits, &w, sizeof(bits));
+  return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+} // END namespace detail
+
+// Edges of the text in [data, data + len), in file order. The
+// number of malformed lines skipped goes to *rejected if given.
+inline std::vector<Edge> parse_edges_text(const char* data, size_t len, ThreadPool& tp,
+                                          size_t* rejected = nullptr)
+{
+  const char* end = data + len;
+  size_t nchunks = std::max<size_t>(1, std::min(tp.size() * 4, len / 4096));
+  std::vector<std::vector<Edge>> parts(nchunks);
+  std::vector<size_t> bad(nchunks, 0);
+
+  // Chunk c owns the lines starting in [c * len / nchunks, (c + 1) * len / nchunks)
+  tp.parallel_for(0, nchunks, [&](size_t b, size_t e) {
+    for (size_t c = b; c < e; c++) {
+      const char* first = data + c * len / nchunks;
+      const char* last = data + (c + 1) * len / nchunks;
+      if (c > 0) {
+        // Skip the line started in the previous chunk
+        auto nl = static_cast<const char*>(std::memchr(first - 1, '\n', end - first + 1));
+        first = nl ? nl + 1 : end;
+      }
+      bad[c] = detail::parse_text_chunk(first, last, end, parts[c]);
+    }
+  });
+
+  std::vector<size_t> offset(nchunks + 1, 0);
+  for (size_t c = 0; c < nchunks; c++) offset[c + 1] = offset[c] + parts[c].size();
+  std::vector<Edge> edges(offset[nchunks]);
+  tp.parallel_for(0, nchunks, [&](size_t b, size_t e) {
+    for (size_t c = b; c < e; c++) {
+      std::copy(parts[c].begin(), parts[c].end(), edges.begin() + offset[c]);
+    }
+  });
+  if (rejected) *rejected = std::accumulate(bad.begin(), bad.end(), size_t(0));
+  return edges;
+}
+
+// Throws std::runtime_error if len is not a whole number of records
+inline std::vector<Edge> parse_edges_binary(const char* data, size_t len, ThreadPool& tp)
+{
+  if (len % sizeof(Edge) != 0) {
+    throw std::runtime_error("binary edge data of " + std::to_string(len) +
+                             " bytes is not a multiple of the " +
+                             std::to_string(sizeof(Edge)) + " byte record");
+  }
+  std::vector<Edge> edges(len / sizeof(Edge));
+  // Parallel copy out of the mapping faults the pages in from all threads
+  tp.parallel_for(0, edges.size(), [&](size_t b, size_t e) {
+    std::memcpy(&edges[b], data + b * sizeof(Edge), (e - b) * sizeof(Edge));
+  });
+  return edges;
+}
+
+/*
+ * Edges of the file at path. Throws std::runtime_error if a binary
+ * file is not a whole number of records, or if a text file has
+ * malformed lines and rejected is null; otherwise the malformed
+ * lines are skipped and counted in *rejected.
+ */
+inline std::vector<Edge> load_edge_file(const std::string& path, ThreadPool& tp,
+                                        size_t* rejected = nullptr)
+{
+  MappedFile file(path);
+  bool binary = path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+  if (binary) {
+    if (rejected) *rejected = 0;
+    try {
+      return parse_edges_binary(file.data(), file.size(), tp);
+    } catch (const std::runtime_error& e) {
+      throw std::runtime_error(path + ": " + e.what());
+    }
+  }
+  size_t bad = 0;
+  auto edges = parse_edges_text(file.data(), file.size(), tp, &bad);
+  if (rejected) *rejected = bad;
+  else if (bad > 0) {
+    throw std::runtime_error(path + ": " + std::to_string(bad) + " malformed edge lines");
+  }
+  return edges;
+}
+
+// Number of vertices, i.e one more than the largest endpoint
+inline size_t vertex_count(const std::vector<Edge>& edges, ThreadPool& tp)
+{
+  std::atomic<size_t> count{0};
+  tp.parallel_for(0, edges.size(), [&](size_t b, size_t e) {
+    size_t m = 0;
+    for (size_t i = b; i < e; i++) m = std::max<size_t>(m, std::max(edges[i].u, edges[i].v) + size_t(1));
+    size_t cur = count.load(std::memory_order_relaxed);
+    while (cur < m && !count.compare_exchange_weak(cur, m, std::memory_order_relaxed));
+  });
+  return count.load();
+}
+
+/*
+ * Stable LSD radix sort by weight, 8 bits per pass. Each pass
+ * counts digits per block in parallel, turns the counts into
+ * per (digit, block) offsets and scatters the blocks in parallel.
+ * Passes where every key has the same digit are skipped.
+ */
+inline void radix_sort_by_weight(std::vector<Edge>& edges, ThreadPool& tp)
+{
+  const size_t n = edges.size();
+  if (n < 2) return;
+  const size_t nblocks = std::min(n, tp.size() * 4);
+  const size_t step = (n + nblocks - 1) / nblocks;
+
+  std::vector<Edge> tmp(n);
+  std::vector<size_t> count(nblocks * 256);
+  Edge* src = edges.data();
+  Edge* dst = tmp.data();
+
+  for (int shift = 0; shift < 32; shift += 8) {
+    std::fill(count.begin(), count.end(), 0);
+    tp.parallel_for(0, nblocks, [&](size_t bb, size_t be) {
+      for (size_t blk = bb; blk < be; blk++) {
+        size_t* cnt = &count[blk * 256];
+        for (size_t i = blk * step; i < std::min(n, (blk + 1) * step); i++) {
+          cnt[(detail::weight_key(src[i].w) >> shift) & 0xff]++;
+        }
+      }
+    });
+
+    // Digit major prefix sums keep the sort stable across blocks
+    size_t sum = 0;
+    bool trivial = false;
+    for (size_t d = 0; d < 256; d++) {
+      size_t digit_total = 0;
+      for (size_t blk = 0; blk < nblocks; blk++) {
+        size_t c = count[blk * 256 + d];
+        count[blk * 256 + d] = sum;
+        sum += c;
+        digit_total += c;
+      }
+      if (digit_total == n) trivial = true;
+    }
+    if (trivial) continue;
+
+    tp.parallel_for(0, nblocks, [&](size_t bb, size_t be) {
+      for (size_t blk = bb; blk < be; blk++) {
+        size_t* pos = &count[blk * 256];
+        for (size_t i = blk * step; i < std::min(n, (blk + 1) * step); i++) {
+          dst[pos[(detail::weight_key(src[i].w) >> shift) & 0xff]++] = src[i];
+        }
+      }
+    });
+    std::swap(src, dst);
+  }
+  if (src != edges.data()) edges.swap(tmp);
+}
+
+struct SpanningForest {
+  std::vector<Edge> edges;
+  double weight = 0;
+  size_t components = 0;
+};
+
+namespace detail {
+
+inline void check_vertex_count(size_t count, size_t n) {
+  if (count > n) {
+    throw std::out_of_range("edge endpoint " + std::to_string(count - 1) +
+                            " out of range for " + std::to_string(n) + " vertices");
+  }
+}
+
+} // END namespace detail
+
+// Minimum spanning forest of the weight sorted edges over n
+// vertices. Throws std::out_of_range if an endpoint is >= n.
+inline SpanningForest kruskal(const std::vector<Edge>& sorted, size_t n)
+{
+  size_t count = 0;
+  for (const auto& e : sorted) count = std::max<size_t>(count, std::max(e.u, e.v) + size_t(1));
+  detail::check_vertex_count(count, n);
+
+  SpanningForest res;
+  DenseDisjointSet djs(n);
+  for (const auto& e : sorted) {
+    if (djs.sets() == 1) break;
+    if (djs.union_set(e.u, e.v)) {
+      res.edges.push_back(e);
+      res.weight += e.w;
+    }
+  }
+  res.components = djs.sets();
+  return res;
+}
+
+// Component label 0..c-1 of each of the n vertices, numbered by
+// the smallest vertex of the component. Throws std::out_of_range
+// if an endpoint is >= n.
+inline std::vector<uint32_t> component_labels(const std::vector<Edge>& edges, size_t n,
+                                              ThreadPool& tp)
+{
+  detail::check_vertex_count(vertex_count(edges, tp), n);
+  ConcurrentDisjointSet djs(n);
+  tp.parallel_for(0, edges.size(), [&](size_t b, size_t e) {
+    for (size_t i = b; i < e; i++) djs.union_set(edges[i].u, edges[i].v);
+  });
+
+  std::vector<uint32_t> root(n);
+  tp.parallel_for(0, n, [&](size_t b, size_t e) {
+    for (size_t i = b; i < e; i++) root[i] = djs.find_set(static_cast<uint32_t>(i));
+  });
+  // Relabel densely in vertex order
+  const uint32_t unset = UINT32_MAX;
+  std::vector<uint32_t> label_of_root(n, unset), labels(n);
+  uint32_t next = 0;
+  for (size_t i = 0; i < n; i++) {
+    auto& l = label_of_root[root[i]];
+    if (l == unset) l = next++;
+    labels[i] = l;
+  }
+  return labels;
+}
+
+}
+#endif
@@ -1,6 +1,15 @@
+#include <algorithm>
 #include <iostream>
 #include "disjoint_set.hpp"
+#include "concurrent_disjoint_set.hpp"
+#include "kruskal.hpp"
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <unordered_map>
 #include <string>
+#include <vector>
 
 using namespace ds;
 
@@ -43,8 +52,291 @@ void test_2()
   djs.print_sets(std::cout);
 }
 
+void test_3()
+{
+  // Against naive relabeling
+  const int n = 5000;
+  DisjointSet<int> djs;
+  std::vector<int> label(n);
+  for (int i = 0; i < n; i++) {
+    djs.make_set(i);
+    label[i] = i;
+  }
+  djs.make_set(0);
+  assert (djs.sets() == n);
+
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> dist(0, n - 1);
+  size_t sets = n;
+  for (int i = 0; i < 3000; i++) {
+    int a = dist(gen), b = dist(gen);
+    int la = label[a], lb = label[b];
+    if (la != lb) {
+      for (auto& l : label) if (l == lb) l = la;
+      sets--;
+    }
+    djs.union_set(a, b);
+    assert (djs.sets() == sets);
+  }
+
+  for (int i = 0; i < 20000; i++) {
+    int a = dist(gen), b = dist(gen);
+    assert ((djs.find_set(a) == djs.find_set(b)) == (label[a] == label[b]));
+  }
+}
+
+void test_dense()
+{
+  DenseDisjointSet djs(1000);
+  assert (djs.size() == 1000 && djs.sets() == 1000);
+
+  // Evens and odds
+  for (uint32_t i = 2; i < 1000; i++) assert (djs.union_set(i, i - 2));
+  assert (djs.sets() == 2);
+  assert (!djs.union_set(10, 500));
+  assert (djs.same_set(1, 999) && !djs.same_set(0, 999));
+  assert (djs.find_set(4) == djs.find_set(998));
+
+  auto id = djs.add();
+  assert (id == 1000 && djs.size() == 1001 && djs.sets() == 3);
+  assert (djs.find_set(id) == id);
+  djs.union_set(id, 0);
+  djs.union_set(1, id);
+  assert (djs.sets() == 1);
+}
+
+void test_concurrent()
+{
+  const uint32_t n = 100000;
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<uint32_t> dist(0, n - 1);
+  std::vector<std::pair<uint32_t, uint32_t>> edges(n * 3 / 4);
+  for (auto& e : edges) e = std::make_pair(dist(gen), dist(gen));
+
+  DenseDisjointSet seq(n);
+  for (auto& e : edges) seq.union_set(e.first, e.second);
+
+  ConcurrentDisjointSet conc(n);
+  size_t merged = conc.union_edges(edges.begin(), edges.end(), 4);
+  assert (conc.sets() == seq.sets());
+  assert (merged == n - conc.sets());
+
+  // Same partition: the roots map one to one
+  std::unordered_map<uint32_t, uint32_t> root_map;
+  for (uint32_t i = 0; i < n; i++) {
+    auto res = root_map.emplace(seq.find_set(i), conc.find_set(i));
+    assert (res.first->second == conc.find_set(i));
+  }
+  assert (root_map.size() == conc.sets());
+
+  // Queries racing with unions
+  ConcurrentDisjointSet chain(n);
+  std::thread querier([&chain, n] {
+    for (uint32_t i = 1; i < n; i += 7) {
+      // Unions happen in order, so i joined implies i - 1 joined
+      if (chain.same_set(0, i)) assert (chain.same_set(0, i - 1));
+    }
+  });
+  for (uint32_t i = 1; i < n; i++) chain.union_set(i - 1, i);
+  querier.join();
+  assert (chain.sets() == 1);
+}
+
+void test_rollback()
+{
+  const uint32_t n = 2000;
+  RollbackDisjointSet djs(n);
+  std::mt19937 gen(13);
+  std::uniform_int_distribution<uint32_t> dist(0, n - 1);
+
+  auto roots = [&djs, n] {
+    std::vector<uint32_t> r(n);
+    for (uint32_t i = 0; i < n; i++) r[i] = djs.find_set(i);
+    return r;
+  };
+
+  for (int i = 0; i < 500; i++) djs.union_set(dist(gen), dist(gen));
+  auto snap1 = djs.snapshot();
+  auto roots1 = roots();
+  auto sets1 = djs.sets();
+
+  // Nested what-ifs, each undone back to its own snapshot
+  for (int round = 0; round < 20; round++) {
+    for (int i = 0; i < 300; i++) djs.union_set(dist(gen), dist(gen));
+    auto snap2 = djs.snapshot();
+    auto roots2 = roots();
+    auto sets2 = djs.sets();
+    for (int i = 0; i < 1000; i++) djs.union_set(dist(gen), dist(gen));
+    djs.rollback(snap2);
+    assert (djs.sets() == sets2 && roots() == roots2);
+    djs.rollback(snap1);
+    assert (djs.sets() == sets1 && roots() == roots1);
+  }
+
+  djs.rollback(0);
+  assert (djs.sets() == n && djs.snapshot() == 0);
+  for (uint32_t i = 0; i < n; i++) assert (djs.find_set(i) == i);
+}
+
+void test_members()
+{
+  DenseDisjointSet dense(100);
+  // Sets of the residues mod 7
+  for (uint32_t i = 7; i < 100; i++) dense.union_set(i, i - 7);
+  for (uint32_t r = 0; r < 7; r++) {
+    std::vector<uint32_t> members;
+    dense.for_each_member(r + 14, [&](uint32_t m) { members.push_back(m); });
+    std::sort(members.begin(), members.end());
+    assert (members.size() == dense.set_size(r));
+    for (size_t j = 0; j < members.size(); j++) assert (members[j] == r + 7 * j);
+  }
+  assert (dense.set_size(0) == 15 && dense.set_size(6) == 14);
+
+  DisjointSet<std::string> djs;
+  for (auto name : {"a", "b", "c", "d", "e"}) djs.make_set(name);
+  djs.union_set("a", "c");
+  djs.union_set("e", "c");
+  assert (djs.set_size("a") == 3 && djs.set_size("b") == 1);
+  std::vector<std::string> members;
+  djs.for_each_member("c", [&](const std::string& m) { members.push_back(m); });
+  std::sort(members.begin(), members.end());
+  assert (members == std::vector<std::string>({"a", "c", "e"}));
+}
+
+void test_kruskal()
+{
+  const uint32_t n = 300;
+  std::mt19937 gen(99);
+  std::uniform_int_distribution<uint32_t> vdist(0, n - 1);
+  std::uniform_int_distribution<int> wdist(-400, 400);
+  std::vector<Edge> edges(5000);
+  // Quarters are exact in text, ties exercise stability
+  for (auto& e : edges) e = Edge{vdist(gen), vdist(gen), wdist(gen) / 4.0f};
+
+  const std::string text_path = "kruskal_test_edges.txt";
+  const std::string bin_path = "kruskal_test_edges.bin";
+  {
+    std::ofstream txt(text_path);
+    txt << "# comment\n% another\n\n";
+    for (size_t i = 0; i < edges.size(); i++) {
+      txt << edges[i].u << "\t" << edges[i].v << " " << edges[i].w << (i % 3 ? "\n" : "\r\n");
+    }
+    txt << "7 8";   // no weight and no trailing newline
+    std::ofstream bin(bin_path, std::ios::binary);
+    bin.write(reinterpret_cast<const char*>(edges.data()), edges.size() * sizeof(Edge));
+  }
+
+  ThreadPool tp(4);
+  auto from_text = load_edge_file(text_path, tp);
+  auto from_bin = load_edge_file(bin_path, tp);
+  std::remove(text_path.c_str());
+  std::remove(bin_path.c_str());
+
+  assert (from_text.size() == edges.size() + 1 && from_bin.size() == edges.size());
+  for (size_t i = 0; i < edges.size(); i++) {
+    assert (from_text[i].u == edges[i].u && from_text[i].v == edges[i].v);
+    assert (from_text[i].w == edges[i].w);
+    assert (std::memcmp(&from_bin[i], &edges[i], sizeof(Edge)) == 0);
+  }
+  assert (from_text.back().u == 7 && from_text.back().v == 8 && from_text.back().w == 1.0f);
+  uint32_t max_vertex = 0;
+  for (auto& e : edges) max_vertex = std::max(max_vertex, std::max(e.u, e.v));
+  assert (vertex_count(from_bin, tp) == max_vertex + 1);
+  assert (vertex_count(std::vector<Edge>(), tp) == 0);
+
+  // Truncated, non numeric, glued, trailing garbage and overflowing lines
+  const std::string bad_text =
+    "1 2\n12\nfoo bar\n3x 4\n5 6 0.5 junk\n7 8 w\n4294967296 1\n"
+    "99999999999999999999 1\n4294967295 0 -2.5\n"
+    "1 3 1e\n1 4 2e+\n1 5 1e999999999999\n1 6 -4e39\n1 7 2.5e3\n1 8 1e-999999999999\n";
+  size_t rejected = 0;
+  auto parsed = parse_edges_text(bad_text.data(), bad_text.size(), tp, &rejected);
+  assert (rejected == 11 && parsed.size() == 4);
+  assert (parsed[0].u == 1 && parsed[0].v == 2 && parsed[0].w == 1.0f);
+  assert (parsed[1].u == UINT32_MAX && parsed[1].v == 0 && parsed[1].w == -2.5f);
+  assert (parsed[2].v == 7 && parsed[2].w == 2500.0f);
+  assert (parsed[3].v == 8 && parsed[3].w == 0.0f);
+  {
+    std::ofstream txt(text_path);
+    txt << bad_text;
+    std::ofstream bin(bin_path, std::ios::binary);
+    bin.write(reinterpret_cast<const char*>(edges.data()), sizeof(Edge) + 5);
+  }
+  bool threw = false;
+  try { load_edge_file(text_path, tp); } catch (const std::runtime_error&) { threw = true; }
+  assert (threw);
+  assert (load_edge_file(text_path, tp, &rejected).size() == 4 && rejected == 11);
+  threw = false;
+  try {
+    load_edge_file(bin_path, tp);
+  } catch (const std::runtime_error& e) {
+    threw = std::string(e.what()).find(bin_path) != std::string::npos;
+  }
+  assert (threw);
+  std::remove(text_path.c_str());
+  std::remove(bin_path.c_str());
+
+  auto expect = edges;
+  std::stable_sort(expect.begin(), expect.end(), [](const Edge& a, const Edge& b) { return a.w < b.w; });
+  radix_sort_by_weight(from_bin, tp);
+  for (size_t i = 0; i < edges.size(); i++) {
+    assert (std::memcmp(&from_bin[i], &expect[i], sizeof(Edge)) == 0);
+  }
+
+  // Prim on the adjacency matrix as the reference forest weight
+  const float inf = 1e30f;
+  std::vector<std::vector<float>> adj(n, std::vector<float>(n, inf));
+  for (auto& e : edges) {
+    if (e.u == e.v) continue;
+    adj[e.u][e.v] = adj[e.v][e.u] = std::min(adj[e.u][e.v], e.w);
+  }
+  std::vector<bool> done(n, false);
+  std::vector<float> best(n, inf);
+  double prim_weight = 0;
+  size_t trees = 0;
+  for (uint32_t iter = 0; iter < n; iter++) {
+    uint32_t pick = n;
+    for (uint32_t v = 0; v < n; v++) {
+      if (!done[v] && (pick == n || best[v] < best[pick])) pick = v;
+    }
+    if (best[pick] == inf) trees++;
+    else prim_weight += best[pick];
+    done[pick] = true;
+    for (uint32_t v = 0; v < n; v++) best[v] = std::min(best[v], adj[pick][v]);
+  }
+
+  auto forest = kruskal(from_bin, n);
+  assert (forest.components == trees);
+  assert (forest.edges.size() == n - trees);
+  assert (forest.weight == prim_weight);
+
+  threw = false;
+  try { kruskal(from_bin, n - 1); } catch (const std::out_of_range&) { threw = true; }
+  assert (threw);
+  threw = false;
+  try { component_labels(edges, max_vertex, tp); } catch (const std::out_of_range&) { threw = true; }
+  assert (threw);
+
+  auto labels = component_labels(edges, n, tp);
+  DenseDisjointSet dense(n);
+  for (auto& e : edges) dense.union_set(e.u, e.v);
+  uint32_t next = 0;
+  for (uint32_t v = 0; v < n; v++) {
+    assert (labels[v] <= next);
+    if (labels[v] == next) next++;
+    for (uint32_t w = 0; w < v; w++) assert ((labels[v] == labels[w]) == dense.same_set(v, w));
+  }
+  assert (next == dense.sets());
+}
+
 int main() {
   test_1();
   test_2();
+  test_3();
+  test_dense();
+  test_concurrent();
+  test_rollback();
+  test_members();
+  test_kruskal();
   return 0;
 }
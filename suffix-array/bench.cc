@@ -0,0 +1,293 @@
+// Build: g++ -std=c++11 -O2 -DNDEBUG -pthread bench.cc -o bench
+// Usage: ./bench [corpus_file ...]
+//        e.g enwik8 or a DNA corpus; without files, synthetic text
+//        of 8 MiB is generated (random bytes, DNA, Fibonacci word)
+#include "suffix_array.hpp"
+#include "suffix_array_search.hpp"
+#include "fm_index.hpp"
+#include "external_suffix_array.hpp"
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace ds;
+
+namespace {
+
+template <typename F>
+double time_ns(F&& f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+using Corpus = std::pair<std::string, std::vector<uint8_t>>;
+
+std::vector<uint8_t> read_file(const std::string& path)
+{
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+/*
+ * random    - uniform bytes, sorted after very few rounds.
+ * dna       - uniform ACGT.
+ * fibonacci - the Fibonacci word, long repeats everywhere: the
+ *             worst case for the number of doubling rounds.
+ */
+std::vector<Corpus> synthetic_corpora(size_t n)
+{
+  std::mt19937 gen(42);
+  std::vector<Corpus> corpora;
+
+  std::vector<uint8_t> random(n);
+  for (auto& c : random) c = static_cast<uint8_t>(gen());
+  corpora.emplace_back("random", std::move(random));
+
+  std::vector<uint8_t> dna(n);
+  for (auto& c : dna) c = "ACGT"[gen() % 4];
+  corpora.emplace_back("dna", std::move(dna));
+
+  std::string prev("b"), fib("a");
+  while (fib.size() < n) {
+    auto next = fib + prev;
+    prev.swap(fib);
+    fib.swap(next);
+  }
+  corpora.emplace_back("fibonacci", std::vector<uint8_t>(fib.begin(), fib.begin() + n));
+  return corpora;
+}
+
+void bench(const Corpus& corpus)
+{
+  const auto& text = corpus.second;
+  auto report = [&](const char* builder, double ns) {
+    std::cout << corpus.first << "\t" << builder << "\t" << text.size()
+              << "\t" << ns / text.size()
+              << "\t" << text.size() * 1e3 / ns << std::endl;
+  };
+
+  sa_group_vec_t sa, sa_is, inv;
+  report("qsufsort", time_ns([&] { sa = qsufsort(text.begin(), text.end(), inv); }));
+  report("sais", time_ns([&] { sa_is = sais(text.begin(), text.end()); }));
+  if (sa != sa_is) std::cout << "mismatch between builders" << std::endl;
+
+  // LCP from qsufsort's ranks, and through PLCP without them
+  sa_group_vec_t lcp, lcp_phi;
+  report("lcp/kasai", time_ns([&] { lcp = kasai_lcp(text.begin(), text.end(), sa, inv); }));
+  report("lcp/phi", time_ns([&] {
+    lcp_phi = lcp_from_plcp(sa, plcp_phi(text.begin(), text.end(), sa));
+  }));
+  if (lcp != lcp_phi) std::cout << "mismatch between lcp builders" << std::endl;
+
+  // 5 bytes per entry instead of 8 for texts past 4 GiB
+  sa_vector_t<uint40> packed;
+  report("sais/uint40", time_ns([&] { packed = sais<uint40>(text.begin(), text.end()); }));
+  for (size_t i = 0; i < sa.size(); i++) {
+    if (packed[i] != static_cast<uint64_t>(sa[i])) {
+      std::cout << "mismatch between builders" << std::endl;
+      break;
+    }
+  }
+
+  // From and to files with a quarter byte of memory per character,
+  // against 9 for qsufsort
+  size_t budget = std::max<size_t>(1 << 20, text.size() / 4);
+  const std::string text_path = "bench_text.tmp", sa_path = "bench_sa.tmp";
+  std::ofstream(text_path, std::ios::binary | std::ios::trunc)
+    .write(reinterpret_cast<const char*>(text.data()), text.size());
+  std::string name = "external/" + std::to_string(budget >> 20) + "MiB";
+  report(name.c_str(), time_ns([&] { build_suffix_array_external(text_path, sa_path, budget); }));
+  sa_group_vec_t ext(text.size());
+  std::ifstream(sa_path, std::ios::binary)
+    .read(reinterpret_cast<char*>(ext.data()), ext.size() * sizeof(int));
+  if (ext != sa) std::cout << "mismatch between builders" << std::endl;
+  std::remove(text_path.c_str());
+  std::remove(sa_path.c_str());
+
+  // build_suffix_array scaling from 1 thread to all cores
+  size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+  for (size_t nt = 1; nt <= max_threads; nt *= 2) {
+    ThreadPool tp(nt);
+    sa_group_vec_t par;
+    name = "parallel/" + std::to_string(nt);
+    report(name.c_str(), time_ns([&] { par = build_suffix_array(text.begin(), text.end(), tp); }));
+    if (par != sa) std::cout << "mismatch between builders" << std::endl;
+  }
+}
+
+// 200k substrings of the text, 8 to 64 bytes
+std::vector<std::string> sample_patterns(const std::vector<uint8_t>& text)
+{
+  std::mt19937 gen(7);
+  std::vector<std::string> patterns(200000);
+  for (auto& p : patterns) {
+    size_t len = 8 + gen() % 57;
+    size_t pos = gen() % (text.size() - len);
+    p.assign(text.begin() + pos, text.begin() + pos + len);
+  }
+  return patterns;
+}
+
+// Queries per second for sample_patterns
+void bench_search(const Corpus& corpus)
+{
+  const auto& text = corpus.second;
+  if (text.size() < 64) return;
+  SuffixArray<> index(text.begin(), text.end());
+  auto patterns = sample_patterns(text);
+
+  auto report = [&](const std::string& what, double ns, size_t check) {
+    std::cout << corpus.first << "\t" << what << "\t" << patterns.size() * 1e9 / ns
+              << " queries/s\t(occurrences " << check << ")" << std::endl;
+  };
+
+  // Plain binary search comparing every byte from the start
+  auto sa = index.suffix_array();
+  size_t check = 0;
+  double ns = time_ns([&] {
+    for (auto& p : patterns) {
+      auto less = [&](int suffix, const std::string& pat) {
+        size_t len = std::min(pat.size(), text.size() - suffix);
+        int c = std::memcmp(&text[suffix], pat.data(), len);
+        return c < 0 || (c == 0 && len < pat.size());
+      };
+      auto greater = [&](const std::string& pat, int suffix) {
+        size_t len = std::min(pat.size(), text.size() - suffix);
+        return std::memcmp(&text[suffix], pat.data(), len) > 0;
+      };
+      check += std::upper_bound(sa, sa + text.size(), p, greater) -
+               std::lower_bound(sa, sa + text.size(), p, less);
+    }
+  });
+  report("count/plain", ns, check);
+
+  check = 0;
+  ns = time_ns([&] {
+    for (auto& p : patterns) check += index.count(p);
+  });
+  report("count/mlr", ns, check);
+
+  // Same search with the LCP array: mm/lcp
+  {
+    std::vector<uint8_t> copy(text);
+    auto sa_copy = sais(copy.begin(), copy.end());
+    auto lcp = kasai_lcp(copy.begin(), copy.end(), sa_copy);
+    SuffixArray<> mm(std::move(copy), std::move(sa_copy), std::move(lcp));
+    check = 0;
+    ns = time_ns([&] {
+      for (auto& p : patterns) check += mm.count(p);
+    });
+    report("count/mm", ns, check);
+  }
+
+  // Listing every occurrence of a highly repetitive text would
+  // only measure the allocator
+  if (check > 100 * patterns.size()) return;
+  size_t max_threads = std::max(4u, std::thread::hardware_concurrency());
+  for (size_t nt = 1; nt <= max_threads; nt *= 2) {
+    ThreadPool tp(nt);
+    std::vector<std::vector<int>> res;
+    ns = time_ns([&] { res = index.batch_locate(patterns, tp); });
+    check = 0;
+    for (auto& r : res) check += r.size();
+    report("batch_locate/" + std::to_string(nt), ns, check);
+  }
+}
+
+// Size and queries per second of the FM-index against the suffix
+// array (5 bytes per character with the text)
+void bench_fm_index(const Corpus& corpus)
+{
+  const auto& text = corpus.second;
+  if (text.size() < 64) return;
+  auto patterns = sample_patterns(text);
+
+  std::vector<int> sa;
+  double build_ns = time_ns([&] { sa = qsufsort(text.begin(), text.end()); });
+  double ns = time_ns([&] { FMIndex<> fm(text.begin(), text.end(), sa); });
+  std::cout << corpus.first << "\tfm/build\t" << (build_ns + ns) / 1e6 << " ms ("
+            << ns / 1e6 << " ms after qsufsort)" << std::endl;
+
+  for (size_t rate : {8, 32, 128}) {
+    FMIndex<> fm(text.begin(), text.end(), sa, rate);
+    std::string name = "fm/" + std::to_string(rate);
+    std::cout << corpus.first << "\t" << name << "\t"
+              << double(fm.bytes()) / text.size() << " bytes/char" << std::endl;
+
+    size_t check = 0;
+    ns = time_ns([&] {
+      for (auto& p : patterns) check += fm.count(p);
+    });
+    std::cout << corpus.first << "\t" << name << "\tcount " << patterns.size() * 1e9 / ns
+              << " queries/s\t(occurrences " << check << ")" << std::endl;
+
+    // Only texts with few repeats, as for batch_locate
+    if (check > 100 * patterns.size()) continue;
+    ns = time_ns([&] {
+      for (auto& p : patterns) check += fm.locate(p).size();
+    });
+    std::cout << corpus.first << "\t" << name << "\tlocate " << patterns.size() * 1e9 / ns
+              << " queries/s" << std::endl;
+  }
+}
+
+// Startup from an index file against building the index
+void bench_index_file(const Corpus& corpus)
+{
+  const auto& text = corpus.second;
+  const std::string path = "bench_index.tmp";
+  auto report = [&](const char* what, double ns) {
+    std::cout << corpus.first << "\t" << what << "\t" << ns / 1e6 << " ms" << std::endl;
+  };
+
+  std::vector<uint8_t> copy(text);
+  double ns = time_ns([&] {
+    auto sa = sais(copy.begin(), copy.end());
+    auto lcp = lcp_from_plcp(sa, plcp_phi(copy.begin(), copy.end(), sa));
+    SuffixArray<> built(std::move(copy), std::move(sa), std::move(lcp));
+    built.save(path);
+  });
+  report("build+save", ns);
+
+  std::string pattern(text.begin() + text.size() / 2, text.begin() + text.size() / 2 + 16);
+  size_t check = 0;
+  ns = time_ns([&] {
+    auto index = SuffixArray<>::open(path);
+    check = index.count(pattern);
+  });
+  report("open+count", ns);
+  if (check == 0) std::cout << "pattern not found in the opened index" << std::endl;
+  std::remove(path.c_str());
+}
+
+} // end anon namespace
+
+int main(int argc, char* argv[])
+{
+  std::vector<Corpus> corpora;
+  for (int i = 1; i < argc; i++) corpora.emplace_back(argv[i], read_file(argv[i]));
+  if (corpora.empty()) corpora = synthetic_corpora(8 << 20);
+
+  std::cout << "corpus\tbuilder\tbytes\tns/byte\tMB/s" << std::endl;
+  for (const auto& c : corpora) bench(c);
+  std::cout << std::endl;
+  for (const auto& c : corpora) bench_search(c);
+  std::cout << std::endl;
+  for (const auto& c : corpora) bench_fm_index(c);
+  std::cout << std::endl;
+  for (const auto& c : corpora) bench_index_file(c);
+  return 0;
+}
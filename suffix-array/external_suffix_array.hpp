@@ -0,0 +1,459 @@
+#ifndef EXTERNAL_SUFFIX_ARRAY_HPP
+#define EXTERNAL_SUFFIX_ARRAY_HPP
+
+#if __cplusplus < 201103L
+#error This header needs atleast a C++11 compliant compiler.
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "suffix_array.hpp"
+
+namespace ds {
+
+namespace detail {
+
+/*
+ * Owned file descriptor. temporary() creates a file in dir and
+ * unlinks it at once, so it goes away with the descriptor even if
+ * the process dies.
+ * Throws std::system_error.
+ */
+class FileHandle
+{
+public:
+  FileHandle(const std::string& path, int flags, mode_t mode = 0644):
+    path_(path)
+  {
+    fd_ = ::open(path.c_str(), flags, mode);
+    if (fd_ < 0) throw std::system_error(errno, std::generic_category(), path_);
+  }
+
+  static FileHandle temporary(const std::string& dir)
+  {
+    std::string name = dir + "/suffix_array.XXXXXX";
+    std::vector<char> tmpl(name.begin(), name.end());
+    tmpl.push_back('\0');
+    int fd = ::mkstemp(tmpl.data());
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), name);
+    ::unlink(tmpl.data());
+    return FileHandle(fd, tmpl.data());
+  }
+
+  FileHandle(const FileHandle&) = delete;
+  void operator=(const FileHandle&) = delete;
+
+  FileHandle(FileHandle&& other) noexcept:
+    path_(std::move(other.path_)),
+    fd_(other.fd_)
+  {
+    other.fd_ = -1;
+  }
+
+  FileHandle& operator=(FileHandle&& other) noexcept {
+    std::swap(path_, other.path_);
+    std::swap(fd_, other.fd_);
+    return *this;
+  }
+
+  ~FileHandle() {
+    if (fd_ >= 0) ::close(fd_);
+  }
+
+public:
+  uint64_t size() const
+  {
+    struct stat st;
+    if (::fstat(fd_, &st) < 0) fail();
+    return static_cast<uint64_t>(st.st_size);
+  }
+
+  void read_at(void* data, size_t bytes, uint64_t offset) const
+  {
+    char* p = static_cast<char*>(data);
+    while (bytes > 0) {
+      ssize_t r = ::pread(fd_, p, bytes, offset);
+      if (r < 0 && errno == EINTR) continue;
+      if (r < 0) fail();
+      if (r == 0) throw std::runtime_error(path_ + ": unexpected end of file");
+      p += r;
+      bytes -= r;
+      offset += r;
+    }
+  }
+
+  void write_at(const void* data, size_t bytes, uint64_t offset) const
+  {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+      ssize_t w = ::pwrite(fd_, p, bytes, offset);
+      if (w < 0 && errno == EINTR) continue;
+      if (w < 0) fail();
+      p += w;
+      bytes -= w;
+      offset += w;
+    }
+  }
+
+private:
+  FileHandle(int fd, std::string path): path_(std::move(path)), fd_(fd) {}
+
+  [[noreturn]] void fail() const {
+    throw std::system_error(errno, std::generic_category(), path_);
+  }
+
+private:
+  std::string path_;
+  int fd_ = -1;
+};
+
+// Buffered sequential reads of the records [first, last) of a file
+template <typename T>
+class RecordReader
+{
+public:
+  RecordReader(const FileHandle& file, uint64_t first, uint64_t last, size_t buffer_records):
+    file_(&file),
+    next_(first),
+    last_(last),
+    buf_(std::max<size_t>(buffer_records, 1))
+  {
+    fill();
+  }
+
+public:
+  bool empty() const noexcept { return pos_ == end_; }
+  const T& front() const noexcept { return buf_[pos_]; }
+
+  void pop() {
+    if (++pos_ == end_) fill();
+  }
+
+private:
+  void fill() {
+    pos_ = 0;
+    end_ = static_cast<size_t>(std::min<uint64_t>(buf_.size(), last_ - next_));
+    if (end_ > 0) file_->read_at(buf_.data(), end_ * sizeof(T), next_ * sizeof(T));
+    next_ += end_;
+  }
+
+private:
+  const FileHandle* file_;
+  uint64_t next_, last_;
+  std::vector<T> buf_;
+  size_t pos_ = 0, end_ = 0;
+};
+
+// Buffered sequential writes of records from record `first` on
+template <typename T>
+class RecordWriter
+{
+public:
+  RecordWriter(const FileHandle& file, size_t buffer_records, uint64_t first = 0):
+    file_(&file),
+    offset_(first)
+  {
+    buf_.reserve(std::max<size_t>(buffer_records, 1));
+  }
+
+public:
+  // Records written so far, counting from 0
+  uint64_t size() const noexcept { return offset_ + buf_.size(); }
+
+  void push(const T& v) {
+    if (buf_.size() == buf_.capacity()) flush();
+    buf_.push_back(v);
+  }
+
+  void flush() {
+    file_->write_at(buf_.data(), buf_.size() * sizeof(T), offset_ * sizeof(T));
+    offset_ += buf_.size();
+    buf_.clear();
+  }
+
+private:
+  const FileHandle* file_;
+  uint64_t offset_;
+  std::vector<T> buf_;
+};
+
+/*
+ * Sort of more records than fit in memory_bytes: records are
+ * gathered into sorted runs of memory_bytes, spilled to a temporary
+ * file, and merged with a heap, in several passes if there are more
+ * runs than read buffers fit into memory at once.
+ */
+template <typename T, typename Less>
+class ExternalSorter
+{
+public:
+  ExternalSorter(size_t memory_bytes, const std::string& tmp_dir, Less less = Less()):
+    memory_(memory_bytes),
+    block_(std::max(sizeof(T), std::min<size_t>(size_t(1) << 20, memory_bytes / 4))),
+    dir_(tmp_dir),
+    less_(less)
+  {
+    buf_.reserve(std::max<size_t>(memory_ / sizeof(T), 1));
+  }
+
+  ExternalSorter(const ExternalSorter&) = delete;
+  void operator=(const ExternalSorter&) = delete;
+
+public:
+  void push(const T& v) {
+    if (buf_.size() == buf_.capacity()) spill();
+    buf_.push_back(v);
+  }
+
+  // Calls f on every record in order. The sorter is spent afterwards
+  template <typename F>
+  void consume(F&& f)
+  {
+    if (runs_.empty()) {
+      std::sort(buf_.begin(), buf_.end(), less_);
+      for (const T& v : buf_) f(v);
+      std::vector<T>().swap(buf_);
+      return;
+    }
+    spill();
+    std::vector<T>().swap(buf_);
+
+    // One read buffer per merged run, and one for writing
+    const size_t fan_in = std::max<size_t>(2, memory_ / block_ - 1);
+    while (runs_.size() > fan_in) {
+      FileHandle out = FileHandle::temporary(dir_);
+      RecordWriter<T> writer(out, block_ / sizeof(T));
+      std::vector<Run> next;
+      for (size_t g = 0; g < runs_.size(); g += fan_in) {
+        uint64_t begin = writer.size();
+        merge(g, std::min(runs_.size(), g + fan_in), [&](const T& v) { writer.push(v); });
+        next.push_back(Run{begin, writer.size()});
+      }
+      writer.flush();
+      file_.reset(new FileHandle(std::move(out)));
+      runs_.swap(next);
+    }
+    merge(0, runs_.size(), f);
+  }
+
+private:
+  // Records [begin, end) of file_
+  struct Run {
+    uint64_t begin, end;
+  };
+
+  void spill()
+  {
+    if (buf_.empty()) return;
+    if (!file_) file_.reset(new FileHandle(FileHandle::temporary(dir_)));
+    std::sort(buf_.begin(), buf_.end(), less_);
+    uint64_t begin = runs_.empty() ? 0 : runs_.back().end;
+    file_->write_at(buf_.data(), buf_.size() * sizeof(T), begin * sizeof(T));
+    runs_.push_back(Run{begin, begin + buf_.size()});
+    buf_.clear();
+  }
+
+  template <typename F>
+  void merge(size_t first_run, size_t last_run, F&& f)
+  {
+    std::vector<RecordReader<T>> readers;
+    readers.reserve(last_run - first_run);
+    for (size_t r = first_run; r < last_run; r++) {
+      readers.emplace_back(*file_, runs_[r].begin, runs_[r].end, block_ / sizeof(T));
+    }
+
+    auto greater = [&](size_t a, size_t b) { return less_(readers[b].front(), readers[a].front()); };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t r = 0; r < readers.size(); r++) {
+      if (!readers[r].empty()) heap.push(r);
+    }
+    while (!heap.empty()) {
+      size_t r = heap.top();
+      heap.pop();
+      f(readers[r].front());
+      readers[r].pop();
+      if (!readers[r].empty()) heap.push(r);
+    }
+  }
+
+private:
+  size_t memory_;
+  size_t block_;
+  std::string dir_;
+  Less less_;
+  std::vector<T> buf_;
+  std::unique_ptr<FileHandle> file_;
+  std::vector<Run> runs_;
+};
+
+// Names of the pairs of ranks (r1, r2) of suffix i
+struct RankTriple {
+  uint64_t r1, r2, i;
+};
+
+struct PosRank {
+  uint64_t i, r;
+};
+
+struct ByRankPair {
+  bool operator()(const RankTriple& a, const RankTriple& b) const noexcept {
+    return a.r1 != b.r1 ? a.r1 < b.r1 : a.r2 < b.r2;
+  }
+};
+
+struct ByPos {
+  bool operator()(const PosRank& a, const PosRank& b) const noexcept { return a.i < b.i; }
+};
+
+// One entry of the output, laid out like index_traits<Index>::vector_type
+template <typename Index>
+struct SAEntry {
+  uint8_t bytes[index_traits<Index>::bytes];
+
+  explicit SAEntry(uint64_t v) noexcept {
+    encode(v, std::is_integral<Index>());
+  }
+
+private:
+  void encode(uint64_t v, std::true_type) noexcept {
+    Index x = static_cast<Index>(v);
+    std::memcpy(bytes, &x, sizeof(x));
+  }
+
+  // Packed entries are little endian on every host
+  void encode(uint64_t v, std::false_type) noexcept {
+    for (size_t b = 0; b < sizeof(bytes); b++) bytes[b] = static_cast<uint8_t>(v >> (8 * b));
+  }
+};
+
+} // end namespace detail
+
+/*
+ * Suffix array of a text file larger than memory, by prefix doubling
+ * over sorted files (Dementiev, Karkkainen, Mehnert and Sanders,
+ * "Better external memory suffix array construction").
+ *
+ * ranks holds, in text order, the rank of the first h bytes of every
+ * suffix: 1 + the number of suffixes with a smaller h prefix, 0 past
+ * the end of the text. It starts at h = 7, the bytes packed 9 bits
+ * each. Every round:
+ * 1. Streams ranks with two sequential cursors h records apart into
+ *    triples (ranks[i], ranks[i + h], i).
+ * 2. Sorts the triples externally by rank pair; renaming them in that
+ *    order gives the ranks of the 2h prefixes, and the positions in
+ *    that order are written to sa_path.
+ * 3. If every name is distinct that order is the suffix array and
+ *    the build stops. Otherwise the new ranks are sorted back into
+ *    text order for the next round with h doubled.
+ * O(n log n log(max lcp)) work, all file access sequential apart
+ * from the merge reads. Rounds follow the longest repeat, like
+ * qsufsort: texts with repeats of length L need log2(L / 7) + 1.
+ *
+ * memory_bytes bounds the sort buffers (the two sorters of a round
+ * share it) and the read and write buffers. Temporary files, about
+ * 40 bytes per character at the peak, go to tmp_dir.
+ * The result has n entries of index_traits<Index>::bytes each, as in
+ * sa_vector_t<Index> memory (host byte order, uint40 little endian):
+ * use int64_t or uint40 beyond 2 GiB.
+ *
+ * Returns the text length. Throws std::system_error on file errors,
+ * std::length_error if the text is too long for Index and
+ * std::invalid_argument if memory_bytes is below 64 KiB.
+ */
+template <typename Index = int>
+uint64_t build_suffix_array_external(const std::string& text_path, const std::string& sa_path,
+                                     size_t memory_bytes, const std::string& tmp_dir = ".")
+{
+  using detail::FileHandle;
+  using detail::RecordReader;
+  using detail::RecordWriter;
+  using Entry = detail::SAEntry<Index>;
+
+  if (memory_bytes < (size_t(1) << 16)) throw std::invalid_argument("memory budget below 64 KiB");
+  const size_t io_bytes = std::min<size_t>(size_t(1) << 20, memory_bytes / 16);
+  const size_t sort_bytes = (memory_bytes - 3 * io_bytes) / 2;
+
+  FileHandle text(text_path, O_RDONLY);
+  const uint64_t n = text.size();
+  detail::check_text_size<Index>(n);
+  FileHandle sa(sa_path, O_WRONLY | O_CREAT | O_TRUNC);
+  if (n == 0) return 0;
+
+  // Initial ranks, the first 7 bytes of each suffix with 0 past the end
+  const unsigned packed_bytes = 7;
+  FileHandle ranks = FileHandle::temporary(tmp_dir);
+  {
+    RecordReader<uint8_t> in(text, 0, n, io_bytes);
+    RecordWriter<uint64_t> out(ranks, io_bytes / sizeof(uint64_t));
+    const uint64_t mask = (uint64_t(1) << (9 * packed_bytes)) - 1;
+    uint64_t window = 0;
+    for (uint64_t i = 0; i < n + packed_bytes - 1; i++) {
+      uint64_t c = 0;
+      if (!in.empty()) {
+        c = in.front() + 1;
+        in.pop();
+      }
+      window = (window << 9 | c) & mask;
+      if (i + 1 >= packed_bytes) out.push(window);
+    }
+    out.flush();
+  }
+
+  for (uint64_t h = packed_bytes;; h *= 2) {
+    detail::ExternalSorter<detail::RankTriple, detail::ByRankPair> triples(sort_bytes, tmp_dir);
+    {
+      RecordReader<uint64_t> first(ranks, 0, n, io_bytes / sizeof(uint64_t));
+      RecordReader<uint64_t> second(ranks, std::min(h, n), n, io_bytes / sizeof(uint64_t));
+      for (uint64_t i = 0; i < n; i++) {
+        uint64_t r2 = 0;
+        if (!second.empty()) {
+          r2 = second.front();
+          second.pop();
+        }
+        triples.push(detail::RankTriple{first.front(), r2, i});
+        first.pop();
+      }
+    }
+
+    detail::ExternalSorter<detail::PosRank, detail::ByPos> renamed(sort_bytes, tmp_dir);
+    RecordWriter<Entry> out(sa, io_bytes / sizeof(Entry));
+    uint64_t k = 0, name = 0, distinct = 0;
+    detail::RankTriple prev{0, 0, 0};
+    triples.consume([&](const detail::RankTriple& t) {
+      if (k == 0 || t.r1 != prev.r1 || t.r2 != prev.r2) {
+        name = k + 1;
+        distinct++;
+      }
+      prev = t;
+      k++;
+      renamed.push(detail::PosRank{t.i, name});
+      out.push(Entry(t.i));
+    });
+    out.flush();
+    if (distinct == n) break;
+
+    ranks = FileHandle::temporary(tmp_dir);
+    RecordWriter<uint64_t> next(ranks, io_bytes / sizeof(uint64_t));
+    renamed.consume([&](const detail::PosRank& p) { next.push(p.r); });
+    next.flush();
+  }
+  return n;
+}
+
+}
+#endif
@@ -0,0 +1,373 @@
+#ifndef FM_INDEX_HPP
+#define FM_INDEX_HPP
+
+#if __cplusplus < 201103L
+#error This header needs atleast a C++11 compliant compiler.
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+#include "suffix_array.hpp"
+
+namespace ds {
+
+namespace detail {
+
+/*
+ * Bit vector with constant time rank. Every 64 byte line holds the
+ * number of ones before it followed by 448 bits, so a rank reads a
+ * single cache line: the count plus the popcount of at most 7 words.
+ * 1/8 of the space goes to the counts.
+ */
+class RankBitVector
+{
+public:
+  explicit RankBitVector(size_t n = 0):
+    size_(n),
+    words_((n / line_bits + 1) * line_words + line_words - 1)
+  {
+    // Lines start on a 64 byte boundary inside the buffer
+    auto addr = reinterpret_cast<uintptr_t>(words_.data());
+    base_ = (line_words - addr / sizeof(uint64_t) % line_words) % line_words;
+  }
+
+  RankBitVector(RankBitVector&&) = default;
+  RankBitVector& operator=(RankBitVector&&) = default;
+
+public:
+  size_t size() const noexcept { return size_; }
+  size_t bytes() const noexcept { return words_.size() * sizeof(uint64_t); }
+
+  void set(size_t i) noexcept {
+    assert (i < size_);
+    words_[word_index(i)] |= uint64_t(1) << (i % 64);
+  }
+
+  bool get(size_t i) const noexcept {
+    assert (i < size_);
+    return (words_[word_index(i)] >> (i % 64)) & 1;
+  }
+
+  // Fills in the line counts once every bit is set
+  void build_ranks() noexcept {
+    uint64_t ones = 0;
+    for (size_t l = 0; l <= size_ / line_bits; l++) {
+      uint64_t* line = &words_[base_ + l * line_words];
+      line[0] = ones;
+      for (size_t w = 1; w < line_words; w++) ones += __builtin_popcountll(line[w]);
+    }
+  }
+
+  // Ones in [0, i)
+  size_t rank1(size_t i) const noexcept {
+    assert (i <= size_);
+    const uint64_t* line = &words_[base_ + i / line_bits * line_words];
+    size_t off = i % line_bits;
+    size_t r = line[0];
+    const uint64_t* w = line + 1;
+    for (; off >= 64; off -= 64) r += __builtin_popcountll(*w++);
+    return r + __builtin_popcountll(*w & ((uint64_t(1) << off) - 1));
+  }
+
+  size_t rank0(size_t i) const noexcept { return i - rank1(i); }
+
+private:
+  static const size_t line_words = 8;
+  static const size_t line_bits = (line_words - 1) * 64;
+
+  size_t word_index(size_t i) const noexcept {
+    return base_ + i / line_bits * line_words + 1 + i % line_bits / 64;
+  }
+
+private:
+  size_t size_;
+  std::vector<uint64_t> words_;
+  size_t base_ = 0;
+};
+
+/*
+ * Wavelet matrix (the level wise layout of a wavelet tree) over
+ * codes 0..sigma-1, with ceil(log2 sigma) levels. Level l holds bit
+ * l (from the top) of every code, the codes are then stably
+ * partitioned by that bit for the next level. Every occurrence of a
+ * code ends up in one contiguous run, so rank(c, i) follows a single
+ * position down the levels: one rank per level.
+ */
+class WaveletMatrix
+{
+public:
+  WaveletMatrix() = default;
+
+  // codes is consumed as scratch
+  WaveletMatrix(std::vector<uint8_t>& codes, size_t sigma):
+    size_(codes.size()),
+    start_(std::max<size_t>(sigma, 1))
+  {
+    while ((size_t(1) << levels_) < sigma) levels_++;
+
+    std::vector<uint8_t> next(size_);
+    for (size_t l = 0; l < levels_; l++) {
+      const unsigned shift = levels_ - 1 - l;
+      RankBitVector bits(size_);
+      size_t zeros = 0;
+      for (size_t i = 0; i < size_; i++) {
+        if ((codes[i] >> shift) & 1) bits.set(i);
+        else zeros++;
+      }
+      bits.build_ranks();
+
+      size_t z = 0, o = zeros;
+      for (size_t i = 0; i < size_; i++) {
+        if ((codes[i] >> shift) & 1) next[o++] = codes[i];
+        else next[z++] = codes[i];
+      }
+      codes.swap(next);
+      levels_bits_.push_back(std::move(bits));
+      zeros_.push_back(zeros);
+    }
+
+    // Where the run of each code starts, descending from position 0
+    for (size_t c = 0; c < start_.size(); c++) {
+      size_t s = 0;
+      for (size_t l = 0; l < levels_; l++) {
+        if ((c >> (levels_ - 1 - l)) & 1) s = zeros_[l] + levels_bits_[l].rank1(s);
+        else s = levels_bits_[l].rank0(s);
+      }
+      start_[c] = s;
+    }
+  }
+
+public:
+  size_t size() const noexcept { return size_; }
+
+  size_t bytes() const noexcept {
+    size_t b = start_.size() * sizeof(size_t) + zeros_.size() * sizeof(size_t);
+    for (auto& bits : levels_bits_) b += bits.bytes();
+    return b;
+  }
+
+  // Occurrences of c in [0, i) and in [0, j), descending together so
+  // that the cache misses of both overlap
+  std::pair<size_t, size_t> rank(unsigned c, size_t i, size_t j) const noexcept {
+    for (size_t l = 0; l < levels_; l++) {
+      const RankBitVector& bits = levels_bits_[l];
+      if ((c >> (levels_ - 1 - l)) & 1) {
+        i = zeros_[l] + bits.rank1(i);
+        j = zeros_[l] + bits.rank1(j);
+      } else {
+        i = bits.rank0(i);
+        j = bits.rank0(j);
+      }
+    }
+    return std::make_pair(i - start_[c], j - start_[c]);
+  }
+
+  // The code at i and its occurrences in [0, i), in one descent
+  std::pair<unsigned, size_t> inverse_select(size_t i) const noexcept {
+    unsigned c = 0;
+    for (size_t l = 0; l < levels_; l++) {
+      const RankBitVector& bits = levels_bits_[l];
+      size_t ones = bits.rank1(i);
+      if (bits.get(i)) {
+        c = c << 1 | 1;
+        i = zeros_[l] + ones;
+      } else {
+        c = c << 1;
+        i = i - ones;
+      }
+    }
+    return std::make_pair(c, i - start_[c]);
+  }
+
+private:
+  size_t size_ = 0;
+  size_t levels_ = 0;
+  std::vector<RankBitVector> levels_bits_;
+  std::vector<size_t> zeros_;
+  std::vector<size_t> start_;
+};
+
+} // end namespace detail
+
+/*
+ * @class FMIndex
+ * Compressed substring index (Ferragina and Manzini): the Burrows
+ * Wheeler transform of the text with rank support, plus a sample of
+ * the suffix array. The text itself is not kept.
+ *
+ * - The BWT comes from the suffix array, with a virtual sentinel
+ *   smaller than every byte. Bytes are renumbered to the sigma codes
+ *   occurring in the text and stored in a wavelet matrix of
+ *   ceil(log2 sigma) levels, each a bit vector with one cache line
+ *   per rank.
+ * - count is a backward search, two ranks per pattern byte.
+ * - locate walks LF from each match to the nearest text position
+ *   that is a multiple of sample_rate, whose suffix array entry is
+ *   stored: at most sample_rate - 1 steps per occurrence.
+ *
+ * Space is about 1.15 * ceil(log2 sigma) / 8 bytes per character for
+ * the BWT, plus 0.15 + sizeof(value_type) / sample_rate for the
+ * samples: with int, 0.55 for DNA and 1.4 for arbitrary bytes at
+ * sample_rate 32.
+ *
+ * Exposed API's:
+ * 1. FMIndex(first, last, sample_rate = 32)
+ *                           - Builds the suffix array with qsufsort
+ *                             (signed Index types).
+ *    FMIndex(first, last, sa, sample_rate = 32)
+ *                           - From a suffix array built by any of
+ *                             the builders.
+ * 2. count(pattern)         - Number of occurrences.
+ * 3. locate(pattern)        - Text positions of the occurrences, in
+ *                             suffix order.
+ * 4. size(), bytes()        - Text length and index size in bytes.
+ */
+template <typename Index = int>
+class FMIndex
+{
+public:
+  using value_type = typename index_traits<Index>::value_type;
+
+public:
+  template <typename Iter>
+  FMIndex(Iter first, Iter last, size_t sample_rate = 32):
+    FMIndex(first, last, qsufsort<Index>(first, last), sample_rate)
+  {}
+
+  template <typename Iter>
+  FMIndex(Iter first, Iter last, const sa_vector_t<Index>& sa, size_t sample_rate = 32):
+    n_(std::distance(first, last)),
+    sample_rate_(sample_rate),
+    marked_(n_ + 1)
+  {
+    static_assert (meta::is_same<std::random_access_iterator_tag, Iter>::value,
+                   "FMIndex needs random access iterators");
+    assert (sa.size() == n_ && sample_rate_ > 0);
+
+    // Renumber the bytes that occur to 0..sigma-1
+    size_t freq[256] = {0,};
+    for (size_t i = 0; i < n_; i++) freq[static_cast<uint8_t>(first[i])]++;
+    size_t sigma = 0;
+    for (size_t c = 0; c < 256; c++) {
+      code_[c] = freq[c] ? static_cast<int16_t>(sigma++) : -1;
+    }
+    // Row 0 is the sentinel suffix, smaller than all the others
+    size_t rows_before = 1;
+    for (size_t c = 0; c < 256; c++) {
+      if (code_[c] < 0) continue;
+      c_.push_back(rows_before);
+      rows_before += freq[c];
+    }
+
+    // Row r > 0 is the suffix sa[r - 1]. The sentinel itself is
+    // stored as code 0, which rank corrects for past primary_
+    auto code_at = [&](size_t pos) {
+      return static_cast<uint8_t>(code_[static_cast<uint8_t>(first[pos])]);
+    };
+    std::vector<uint8_t> bwt(n_ + 1);
+    if (n_ > 0) bwt[0] = code_at(n_ - 1);
+    for (size_t r = 1; r <= n_; r++) {
+      size_t pos = sa[r - 1];
+      if (pos == 0) {
+        primary_ = r;
+        bwt[r] = 0;
+      } else {
+        bwt[r] = code_at(pos - 1);
+      }
+      if (pos % sample_rate_ == 0) {
+        marked_.set(r);
+        samples_.push_back(pos);
+      }
+    }
+    marked_.build_ranks();
+    samples_.shrink_to_fit();
+    bwt_ = detail::WaveletMatrix(bwt, sigma);
+  }
+
+  FMIndex(const FMIndex&) = delete;
+  void operator=(const FMIndex&) = delete;
+  FMIndex(FMIndex&&) = default;
+
+public:
+  size_t size() const noexcept { return n_; }
+
+  size_t bytes() const noexcept {
+    return bwt_.bytes() + marked_.bytes() + samples_.capacity() * sizeof(value_type) +
+           c_.size() * sizeof(size_t) + sizeof(*this);
+  }
+
+  size_t count(const std::string& pattern) const noexcept
+  {
+    auto r = rows(pattern);
+    return r.second - r.first;
+  }
+
+  std::vector<value_type> locate(const std::string& pattern) const
+  {
+    auto r = rows(pattern);
+    std::vector<value_type> res;
+    res.reserve(r.second - r.first);
+    for (size_t row = r.first; row < r.second; row++) {
+      size_t steps = 0;
+      size_t cur = row;
+      while (!marked_.get(cur)) {
+        cur = lf(cur);
+        steps++;
+      }
+      res.push_back(static_cast<value_type>(samples_[marked_.rank1(cur)] + steps));
+    }
+    return res;
+  }
+
+private:
+  // [begin, end) of the rows prefixed by pattern, backward search
+  std::pair<size_t, size_t> rows(const std::string& pattern) const noexcept
+  {
+    // Every row, except that the sentinel suffix does not count as
+    // an occurrence of the empty pattern
+    if (pattern.empty()) return std::make_pair(size_t(1), n_ + 1);
+    size_t sp = 0, ep = n_ + 1;
+    for (size_t k = pattern.size(); k-- > 0 && sp < ep;) {
+      int c = code_[static_cast<uint8_t>(pattern[k])];
+      if (c < 0) return std::make_pair(size_t(0), size_t(0));
+      auto r = bwt_.rank(c, sp, ep);
+      if (c == 0) {
+        r.first -= sp > primary_;
+        r.second -= ep > primary_;
+      }
+      sp = c_[c] + r.first;
+      ep = c_[c] + r.second;
+    }
+    return sp < ep ? std::make_pair(sp, ep) : std::make_pair(size_t(0), size_t(0));
+  }
+
+  // Row of the suffix one position before the suffix of row r
+  size_t lf(size_t r) const noexcept
+  {
+    assert (r != primary_);
+    auto cr = bwt_.inverse_select(r);
+    if (cr.first == 0 && r > primary_) cr.second--;
+    return c_[cr.first] + cr.second;
+  }
+
+private:
+  size_t n_;
+  size_t sample_rate_;
+  // Row of the suffix starting at 0, whose BWT byte is the sentinel
+  size_t primary_ = 0;
+  int16_t code_[256];
+  // First row of the suffixes starting with each code
+  std::vector<size_t> c_;
+  detail::WaveletMatrix bwt_;
+  // Rows whose suffix starts at a multiple of sample_rate
+  detail::RankBitVector marked_;
+  std::vector<value_type> samples_;
+};
+
+}
+#endif
@@ -1,10 +1,18 @@
 #ifndef SUFFIX_ARRAY_HPP
 #define SUFFIX_ARRAY_HPP
 
-#include <iostream>
 #include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#include "../util/thread_pool.hpp"
 
 namespace ds {
 
@@ -47,79 +55,393 @@ namespace meta {
 } // end meta namespace
 
 //-------------------------------------------
-/// Suffix Array Implementation starts here
+/// Index types
 //-------------------------------------------
 
-template <typename Cont>
-void print_container(Cont& c)
+/*
+ * @class packed_index_vector
+ * Vector of unsigned integers stored in Bytes bytes each, little
+ * endian, e.g 5 bytes (40 bits) per suffix array entry for texts
+ * up to 1 TiB instead of 8 bytes.
+ * data() returns a packed_index_ptr, which indexes and offsets like
+ * a plain pointer and yields proxy references, so the builders run
+ * on it unchanged.
+ *
+ * Exposed API's:
+ * 1. operator[](i)  - Proxy reference, converts to and assigns
+ *                     from uint64_t.
+ * 2. data(), size(), operator==
+ */
+template <size_t Bytes>
+class packed_index_ptr
+{
+  static_assert (Bytes >= 1 && Bytes <= 8, "Bytes must be 1 to 8");
+
+public:
+  class reference
+  {
+  public:
+    explicit reference(uint8_t* p) noexcept: p_(p) {}
+
+    // A whole word is read (the vector is padded for the last entry)
+    // but only Bytes bytes are written, so neighbouring entries can
+    // be written concurrently.
+    operator uint64_t() const noexcept {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      uint64_t v;
+      std::memcpy(&v, p_, sizeof(v));
+      return Bytes == 8 ? v : v & ((uint64_t(1) << (8 * Bytes % 64)) - 1);
+#else
+      uint64_t v = 0;
+      for (size_t b = 0; b < Bytes; b++) v |= static_cast<uint64_t>(p_[b]) << (8 * b);
+      return v;
+#endif
+    }
+
+    reference& operator=(uint64_t v) noexcept {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      std::memcpy(p_, &v, Bytes);
+#else
+      for (size_t b = 0; b < Bytes; b++) p_[b] = static_cast<uint8_t>(v >> (8 * b));
+#endif
+      return *this;
+    }
+
+    reference& operator=(const reference& other) noexcept {
+      return *this = static_cast<uint64_t>(other);
+    }
+
+  private:
+    uint8_t* p_;
+  };
+
+public:
+  explicit packed_index_ptr(uint8_t* p) noexcept: p_(p) {}
+
+  reference operator[](size_t i) const noexcept { return reference(p_ + i * Bytes); }
+  packed_index_ptr operator+(size_t i) const noexcept { return packed_index_ptr(p_ + i * Bytes); }
+  const uint8_t* entry_address(size_t i) const noexcept { return p_ + i * Bytes; }
+
+private:
+  uint8_t* p_;
+};
+
+template <size_t Bytes>
+class packed_index_vector
+{
+public:
+  using value_type = uint64_t;
+  using pointer = packed_index_ptr<Bytes>;
+  using reference = typename pointer::reference;
+
+public:
+  explicit packed_index_vector(size_t n = 0):
+    size_(n),
+    bytes_(n * Bytes + sizeof(uint64_t) - Bytes)
+  {}
+
+public:
+  size_t size() const noexcept { return size_; }
+
+  pointer data() noexcept { return pointer(bytes_.data()); }
+
+  // Address of entry i, e.g for prefetching
+  const uint8_t* entry_address(size_t i) const noexcept { return bytes_.data() + i * Bytes; }
+
+  reference operator[](size_t i) noexcept { return data()[i]; }
+
+  value_type operator[](size_t i) const noexcept {
+    return reference(const_cast<uint8_t*>(bytes_.data()) + i * Bytes);
+  }
+
+  bool operator==(const packed_index_vector& other) const { return bytes_ == other.bytes_; }
+  bool operator!=(const packed_index_vector& other) const { return bytes_ != other.bytes_; }
+
+private:
+  size_t size_;
+  std::vector<uint8_t> bytes_;
+};
+
+// Index tag for suffix arrays packed in 40 bits per entry
+struct uint40 {};
+
+/*
+ * Maps the Index parameter of the builders to the integer they
+ * compute with and the container they return: std::vector<Index>
+ * for the integer types, packed_index_vector<5> for uint40.
+ * const_pointer reads entries in place, e.g from a mapped file.
+ * bytes is the size of an entry.
+ * max() marks empty slots, so texts must be shorter than it.
+ */
+template <typename Index>
+struct index_traits
+{
+  static_assert (std::is_integral<Index>::value, "Index must be an integer type or uint40");
+  using value_type = Index;
+  using vector_type = std::vector<Index>;
+  using const_pointer = const Index*;
+  static const size_t bytes = sizeof(Index);
+  static constexpr value_type max() noexcept { return std::numeric_limits<Index>::max(); }
+
+  static const_pointer view(const uint8_t* p) noexcept { return reinterpret_cast<const_pointer>(p); }
+  static const_pointer view(const vector_type& v) noexcept { return v.data(); }
+};
+
+// Views never write, the proxies only need a non const address
+template <>
+struct index_traits<uint40>
+{
+  using value_type = uint64_t;
+  using vector_type = packed_index_vector<5>;
+  using const_pointer = packed_index_ptr<5>;
+  static const size_t bytes = 5;
+  static constexpr value_type max() noexcept { return (uint64_t(1) << 40) - 1; }
+
+  static const_pointer view(const uint8_t* p) noexcept {
+    return const_pointer(const_cast<uint8_t*>(p));
+  }
+  static const_pointer view(const vector_type& v) noexcept { return view(v.entry_address(0)); }
+};
+
+template <typename Index>
+using sa_vector_t = typename index_traits<Index>::vector_type;
+
+namespace detail {
+
+template <typename Index>
+void check_text_size(size_t n)
 {
-  for (auto& e : c) {
-    std::cout << e << " ";
+  if (static_cast<uint64_t>(n) >= static_cast<uint64_t>(index_traits<Index>::max())) {
+    throw std::length_error("text too long for the suffix array index type");
   }
-  std::cout << std::endl;
 }
 
+} // end namespace detail
+
+//-------------------------------------------
+/// Suffix Array Implementation starts here
+//-------------------------------------------
+
 template <typename T, size_t N>
 size_t arr_size(T(&arr)[N]) { return N; }
 
-template <typename Iter>
-sa_group_vec_t sort_by_first_byte(Iter first, Iter last)
+template <typename Index = int, typename Iter>
+std::vector<Index> sort_by_first_byte(Iter first, Iter last)
 {
-  sa_group_vec_t sa(std::distance(first, last));
-  int count[256] = {0,};
+  std::vector<Index> sa(std::distance(first, last));
+  size_t count[256] = {0,};
 
-  std::for_each(first, last, [&count](meta::iter_value_type<Iter> v){ count[v]++; });
+  std::for_each(first, last, [&count](meta::iter_value_type<Iter> v){ count[static_cast<uint8_t>(v)]++; });
 
   // Store the index of the symbol in count array
-  uint64_t sum = 0;
-  for (int i = 0; i < arr_size(count); i++) {
+  size_t sum = 0;
+  for (auto& c : count) {
     auto tmp = sum;
-    sum += count[i];
-    count[i] = tmp;
+    sum += c;
+    c = tmp;
   }
 
-  auto tmp = first;
-  while (tmp != last) {
-    sa[count[*tmp]] = std::distance(first, tmp);
-    count[*tmp]++;
-    ++tmp;
+  Index i = 0;
+  for (auto tmp = first; tmp != last; ++tmp, ++i) {
+    sa[count[static_cast<uint8_t>(*tmp)]++] = i;
   }
 
   return sa;
 }
 
-template <typename Iter>
-sa_inv_vec_t init_sa_groups(Iter first, Iter last, sa_group_vec_t& sa)
+/*
+ * Numbers every group of suffixes sharing their first byte by the
+ * last position of the group in sa, and marks singleton groups as
+ * sorted by a negated length (-1) in sa.
+ */
+template <typename Iter, typename Index>
+std::vector<Index> init_sa_groups(Iter first, Iter last, std::vector<Index>& sa)
 {
-  sa_inv_vec_t inv(std::distance(first, last));
-  auto prev_group = inv.size() - 1;
-  auto prev_byte = *std::next(first, sa[prev_group]);
+  static_assert (std::is_signed<Index>::value, "sorted groups are negative lengths");
+  auto byte_at = [first](Index pos) { return static_cast<uint8_t>(*std::next(first, pos)); };
+
+  std::vector<Index> inv(std::distance(first, last));
+  const Index n = static_cast<Index>(sa.size());
+  Index prev_group = n - 1;
+  auto prev_byte = byte_at(sa[prev_group]);
 
-  for (int i = sa.size() - 1; i >= 0; i--) {
-    auto byte = *std::next(first, sa[i]);
+  for (Index i = n - 1; i >= 0; i--) {
+    auto byte = byte_at(sa[i]);
     if (byte < prev_byte) {
       if (prev_group == i + 1) {
-      	sa[i+1] = -1;
+        sa[i+1] = -1;
       }
       prev_byte = byte;
       prev_group = i;
-
-      if (prev_group == 0) {
-      	sa[0] = 0;
-      }
     }
     inv[sa[i]] = prev_group;
+    if (prev_group == 0) {
+      sa[0] = -1;
+    }
   }
 
   // Separate out the final suffix to the start of its group.
   // This is necessary to ensure the suffix "a" is before "aba"
   // when using a potentially unstable sort.
-  // TODO
+  auto last_byte = byte_at(n - 1);
+  Index group_start = -1;
+  for (Index i = 0; i < n; i++) {
+    if (sa[i] < 0) continue;
+    if (group_start == -1 && byte_at(sa[i]) == last_byte) {
+      group_start = i;
+    }
+    if (sa[i] == n - 1) {
+      std::swap(sa[i], sa[group_start]);
+      inv[sa[group_start]] = group_start;
+      sa[group_start] = -1;
+      break;
+    }
+  }
 
   return inv;
 }
 
-template <typename Iter, 
+namespace detail {
+
+/*
+ * Doubling step of Larsson and Sadakane, "Faster Suffix Sorting".
+ * An unsorted group of h-sorted suffixes is refined to 2h by a
+ * ternary split quicksort keyed on the group of the suffix h
+ * further on, inv[sa[i] + h]. New groups are numbered as they are
+ * split off, smallest first, which keeps every key read during the
+ * split consistent.
+ */
+template <typename Index>
+class QSufSortStep
+{
+public:
+  QSufSortStep(Index* sa, Index* inv, Index h) noexcept:
+    sa_(sa), inv_(inv), h_(h)
+  {}
+
+public:
+  void sort_split(Index* p, Index n) noexcept
+  {
+    if (n < 7) {
+      select_sort_split(p, n);
+      return;
+    }
+
+    Index v = choose_pivot(p, n);
+    // Split-end partition: == v collected at both ends
+    Index* pa = p;
+    Index* pb = p;
+    Index* pc = p + n - 1;
+    Index* pd = p + n - 1;
+    while (true) {
+      Index f;
+      while (pb <= pc && (f = key(pb)) <= v) {
+        if (f == v) std::swap(*pa++, *pb);
+        ++pb;
+      }
+      while (pc >= pb && (f = key(pc)) >= v) {
+        if (f == v) std::swap(*pc, *pd--);
+        --pc;
+      }
+      if (pb > pc) break;
+      std::swap(*pb++, *pc--);
+    }
+
+    // Move the == v ends to the middle
+    Index* pn = p + n;
+    auto s = std::min(pa - p, pb - pa);
+    std::swap_ranges(p, p + s, pb - s);
+    s = std::min(pd - pc, pn - pd - 1);
+    std::swap_ranges(pb, pb + s, pn - s);
+
+    Index less = pb - pa;
+    Index greater = pd - pc;
+    if (less > 0) sort_split(p, less);
+    update_group(p + less, p + n - greater - 1);
+    if (greater > 0) sort_split(p + n - greater, greater);
+  }
+
+private:
+  Index key(const Index* p) const noexcept { return inv_[*p + h_]; }
+
+  Index med3(Index* a, Index* b, Index* c) const noexcept
+  {
+    Index ka = key(a), kb = key(b), kc = key(c);
+    if (ka < kb) return kb < kc ? kb : (ka < kc ? kc : ka);
+    return kb > kc ? kb : (ka > kc ? kc : ka);
+  }
+
+  // Middle key for small ranges, median of 3, or pseudo median of 9
+  Index choose_pivot(Index* p, Index n) const noexcept
+  {
+    Index* pm = p + n / 2;
+    if (n <= 7) return key(pm);
+    Index* pl = p;
+    Index* pn = p + n - 1;
+    if (n > 40) {
+      Index s = n / 8;
+      Index kl = med3(pl, pl + s, pl + 2 * s);
+      Index km = med3(pm - s, pm, pm + s);
+      Index kn = med3(pn - 2 * s, pn - s, pn);
+      return std::max(std::min(kl, km), std::min(std::max(kl, km), kn));
+    }
+    return med3(pl, pm, pn);
+  }
+
+  // Repeatedly picks out the group of the smallest key
+  void select_sort_split(Index* p, Index n) noexcept
+  {
+    Index* pa = p;
+    Index* pn = p + n - 1;
+    while (pa < pn) {
+      Index* pb = pa + 1;
+      Index f = key(pa);
+      for (Index* pi = pa + 1; pi <= pn; ++pi) {
+        Index v = key(pi);
+        if (v < f) {
+          f = v;
+          std::swap(*pi, *pa);
+          pb = pa + 1;
+        } else if (v == f) {
+          std::swap(*pi, *pb++);
+        }
+      }
+      update_group(pa, pb - 1);
+      pa = pb;
+    }
+    if (pa == pn) update_group(pa, pa);
+  }
+
+  // [pl, pm] is a new group, numbered by its last position
+  void update_group(Index* pl, Index* pm) noexcept
+  {
+    Index g = pm - sa_;
+    for (Index* p = pl; p <= pm; ++p) inv_[*p] = g;
+    if (pl == pm) *pl = -1;
+  }
+
+private:
+  Index* sa_;
+  Index* inv_;
+  Index h_;
+};
+
+} // end namespace detail
+
+/*
+ * Larsson-Sadakane qsufsort, O(n log n).
+ * Starting from the suffixes bucketed by their first byte, every
+ * round doubles the sorted prefix length h by splitting each
+ * unsorted group on the rank of the suffixes h positions on.
+ * Runs of sorted groups are kept in sa as one negated total length
+ * so later rounds skip over them in one step. Ends when the whole
+ * array is one sorted run; sa is then rebuilt from inv.
+ * Index must be signed, e.g int64_t past 2 GiB of text.
+ * The final inv, the rank of every suffix (inv[sa[i]] == i), is
+ * handed back for LCP construction.
+ */
+template <typename Index = int,
+	 typename Iter, 
 	 typename = typename std::enable_if<
 		      meta::is_same<std::forward_iterator_tag, Iter>::value       |
 		      meta::is_same<std::bidirectional_iterator_tag, Iter>::value |
@@ -127,17 +449,602 @@ template <typename Iter,
 		       >::type,
 	 typename = typename std::enable_if<
 		      meta::is_one_of<typename std::iterator_traits<Iter>::value_type, uint8_t, char>::value>>
-sa_group_vec_t qsufsort(Iter first, Iter last)
+std::vector<Index> qsufsort(Iter first, Iter last, std::vector<Index>& inv)
 {
-  sa_group_vec_t sa = sort_by_first_byte(first, last);
-  sa_inv_vec_t inv = init_sa_groups(first, last, sa);
+  static_assert (std::is_signed<Index>::value, "qsufsort needs a signed Index");
+  detail::check_text_size<Index>(std::distance(first, last));
+  std::vector<Index> sa = sort_by_first_byte<Index>(first, last);
+  const Index n = static_cast<Index>(sa.size());
+  if (n < 2) {
+    inv.assign(n, 0);
+    return sa;
+  }
+  inv = init_sa_groups(first, last, sa);
 
-  print_container(sa);
-  print_container(inv);
+  for (Index h = 1; sa[0] > -n; h *= 2) {
+    detail::QSufSortStep<Index> step(sa.data(), inv.data(), h);
+    Index pi = 0;     // First position of the current group
+    Index sl = 0;     // Negated length of the sorted groups before pi
+    while (pi < n) {
+      Index s = sa[pi];
+      if (s < 0) {
+        pi -= s;
+        sl += s;
+      } else {
+        if (sl) {
+          // Combine the sorted groups before pi
+          sa[pi + sl] = sl;
+          sl = 0;
+        }
+        Index pk = inv[s] + 1;
+        step.sort_split(&sa[pi], pk - pi);
+        pi = pk;
+      }
+    }
+    if (sl) sa[pi + sl] = sl;
+  }
 
+  for (Index i = 0; i < n; i++) sa[inv[i]] = i;
   return sa;
 }
 
+template <typename Index = int,
+	 typename Iter, 
+	 typename = typename std::enable_if<
+		      meta::is_same<std::forward_iterator_tag, Iter>::value       |
+		      meta::is_same<std::bidirectional_iterator_tag, Iter>::value |
+		      meta::is_same<std::random_access_iterator_tag, Iter>::value
+		       >::type,
+	 typename = typename std::enable_if<
+		      meta::is_one_of<typename std::iterator_traits<Iter>::value_type, uint8_t, char>::value>>
+std::vector<Index> qsufsort(Iter first, Iter last)
+{
+  std::vector<Index> inv;
+  return qsufsort<Index>(first, last, inv);
+}
+
+namespace detail {
+
+// Symbols of a char/uint8_t text as 0..255
+template <typename Iter>
+struct ByteText {
+  Iter first;
+  unsigned operator[](size_t i) const { return static_cast<uint8_t>(first[i]); }
+};
+
+/*
+ * SA-IS of Nong, Zhang and Chan, "Two Efficient Algorithms for
+ * Linear Time Suffix Array Construction".
+ * s[0..n) has symbols in [0, K) and is followed by a virtual
+ * sentinel smaller than every symbol. Besides sa the workspace is
+ * one type bit per symbol and K bucket counters per level: the
+ * reduced problem, at most n/2 long, lives in the upper half of sa
+ * and its suffix array in the lower half.
+ * SA is an Index* or a packed_index_ptr; empty slots hold max().
+ */
+template <typename Index>
+class SAIS
+{
+public:
+  using value_type = typename index_traits<Index>::value_type;
+
+public:
+  template <typename Text, typename SA>
+  static void build(Text s, SA sa, value_type n, size_t K)
+  {
+    using V = value_type;
+    if (n == 0) return;
+    if (n == 1) {
+      sa[0] = 0;
+      return;
+    }
+
+    // stype[i]: suffix i is smaller than suffix i + 1.
+    // The last symbol is L type against the sentinel.
+    std::vector<bool> stype(n, false);
+    for (V i = n - 1; i-- > 0;) {
+      stype[i] = s[i] < s[i + 1] || (s[i] == s[i + 1] && stype[i + 1]);
+    }
+    auto is_lms = [&stype](V i) { return i != empty && i > 0 && stype[i] && !stype[i - 1]; };
+
+    std::vector<V> bkt(K);
+
+    // 1. Sort the LMS substrings by inducing from the LMS positions
+    bucket_ends(s, n, bkt);
+    fill_empty(sa, 0, n);
+    for (V i = n - 1; i > 0; i--) {
+      if (is_lms(i)) sa[--bkt[s[i]]] = i;
+    }
+    induce(s, sa, n, stype, bkt);
+
+    // 2. Compact the sorted LMS positions to the front and name them
+    V m = 0;
+    for (V i = 0; i < n; i++) {
+      V pos = sa[i];
+      if (is_lms(pos)) sa[m++] = pos;
+    }
+    fill_empty(sa, m, n);
+    V names = 0;
+    V prev = empty;
+    for (V i = 0; i < m; i++) {
+      V pos = sa[i];
+      if (prev == empty || !equal_lms_substr(s, n, stype, is_lms, prev, pos)) names++;
+      // LMS positions are at least 2 apart, so pos / 2 is unique
+      sa[m + pos / 2] = names - 1;
+      prev = pos;
+    }
+    // Reduced string in text order at the end of sa
+    SA s1 = sa + (n - m);
+    for (V i = n, j = n; i-- > m;) {
+      V name = sa[i];
+      if (name != empty) sa[--j] = name;
+    }
+
+    // 3. Order of the LMS suffixes, recursing if names repeat
+    if (names < m) {
+      build(s1, sa, m, names);
+    } else {
+      for (V i = 0; i < m; i++) sa[s1[i]] = i;
+    }
+
+    // 4. Induce the full order from the sorted LMS suffixes
+    for (V i = 1, j = 0; i < n; i++) {
+      if (is_lms(i)) s1[j++] = i;
+    }
+    for (V i = 0; i < m; i++) sa[i] = s1[sa[i]];
+    fill_empty(sa, m, n);
+    bucket_ends(s, n, bkt);
+    for (V i = m; i-- > 0;) {
+      V pos = sa[i];
+      sa[i] = empty;
+      sa[--bkt[s[pos]]] = pos;
+    }
+    induce(s, sa, n, stype, bkt);
+  }
+
+private:
+  static constexpr value_type empty = index_traits<Index>::max();
+
+  template <typename SA>
+  static void fill_empty(SA sa, value_type first, value_type last)
+  {
+    for (value_type i = first; i < last; i++) sa[i] = empty;
+  }
+
+  template <typename Text>
+  static void bucket_counts(Text s, value_type n, std::vector<value_type>& bkt)
+  {
+    std::fill(bkt.begin(), bkt.end(), 0);
+    for (value_type i = 0; i < n; i++) bkt[s[i]]++;
+  }
+
+  template <typename Text>
+  static void bucket_ends(Text s, value_type n, std::vector<value_type>& bkt)
+  {
+    bucket_counts(s, n, bkt);
+    value_type sum = 0;
+    for (auto& b : bkt) b = sum += b;
+  }
+
+  template <typename Text>
+  static void bucket_starts(Text s, value_type n, std::vector<value_type>& bkt)
+  {
+    bucket_counts(s, n, bkt);
+    value_type sum = 0;
+    for (auto& b : bkt) {
+      value_type c = b;
+      b = sum;
+      sum += c;
+    }
+  }
+
+  // L types left to right from the bucket heads, then S types
+  // right to left from the bucket tails
+  template <typename Text, typename SA>
+  static void induce(Text s, SA sa, value_type n, const std::vector<bool>& stype,
+                     std::vector<value_type>& bkt)
+  {
+    bucket_starts(s, n, bkt);
+    // Suffix n - 1 is preceded by the sentinel in sorted order
+    sa[bkt[s[n - 1]]++] = n - 1;
+    for (value_type i = 0; i < n; i++) {
+      value_type pos = sa[i];
+      if (pos != empty && pos > 0 && !stype[pos - 1]) sa[bkt[s[pos - 1]]++] = pos - 1;
+    }
+    bucket_ends(s, n, bkt);
+    for (value_type i = n; i-- > 0;) {
+      value_type pos = sa[i];
+      if (pos != empty && pos > 0 && stype[pos - 1]) sa[--bkt[s[pos - 1]]] = pos - 1;
+    }
+  }
+
+  template <typename Text, typename IsLMS>
+  static bool equal_lms_substr(Text s, value_type n, const std::vector<bool>& stype,
+                               IsLMS is_lms, value_type p, value_type q)
+  {
+    for (value_type d = 0; ; d++) {
+      // Only the substring running into the sentinel reaches n
+      if (p + d == n || q + d == n) return false;
+      if (s[p + d] != s[q + d] || stype[p + d] != stype[q + d]) return false;
+      if (d > 0) {
+        bool end_p = is_lms(p + d), end_q = is_lms(q + d);
+        if (end_p || end_q) return end_p && end_q;
+      }
+    }
+  }
+};
+
+template <typename Index>
+constexpr typename SAIS<Index>::value_type SAIS<Index>::empty;
+
+template <typename Index, typename Iter>
+sa_vector_t<Index> sais_impl(Iter first, Iter last, std::random_access_iterator_tag)
+{
+  size_t n = std::distance(first, last);
+  check_text_size<Index>(n);
+  sa_vector_t<Index> sa(n);
+  SAIS<Index>::build(ByteText<Iter>{first}, sa.data(), n, 256);
+  return sa;
+}
+
+template <typename Index, typename Iter>
+sa_vector_t<Index> sais_impl(Iter first, Iter last, std::forward_iterator_tag)
+{
+  std::vector<uint8_t> text(first, last);
+  return sais_impl<Index>(text.cbegin(), text.cend(), std::random_access_iterator_tag());
+}
+
+} // end namespace detail
+
+/*
+ * Linear time suffix array by induced sorting (SA-IS).
+ * Same interface and result as qsufsort, for any Index including
+ * the unsigned types and uint40. The text is read through the
+ * iterators directly when they are random access; other iterators
+ * are first copied into a byte buffer.
+ */
+template <typename Index = int,
+	 typename Iter, 
+	 typename = typename std::enable_if<
+		      meta::is_one_of<typename std::iterator_traits<Iter>::value_type, uint8_t, char>::value>::type>
+sa_vector_t<Index> sais(Iter first, Iter last)
+{
+  return detail::sais_impl<Index>(first, last, typename std::iterator_traits<Iter>::iterator_category());
+}
+
+namespace detail {
+
+// Calls f(block, begin, end) for nblocks blocks of [0, n) in parallel
+template <typename F>
+void for_each_block(size_t n, size_t nblocks, ThreadPool& tp, F&& f)
+{
+  size_t step = (n + nblocks - 1) / nblocks;
+  tp.parallel_for(0, nblocks, [&](size_t bb, size_t be) {
+    for (size_t blk = bb; blk < be; blk++) {
+      f(blk, std::min(n, blk * step), std::min(n, (blk + 1) * step));
+    }
+  });
+}
+
+/*
+ * Parallel prefix doubling.
+ * Suffixes are ranked by the sa position of the head of their group,
+ * so a suffix alone in its group already has its final rank. Each
+ * round only the suffixes of unsorted groups (kept in sa order, with
+ * their sa positions in pos_) are radix sorted on the pair
+ * (rank[i], rank[i + h]); the new groups then take the position of
+ * their first member as rank and the singletons drop out.
+ * Every step is split over per thread blocks: histograms and
+ * scatters of the radix sort, and the block scans that carry the
+ * last group head across blocks.
+ */
+template <typename Index>
+class ParallelDoubling
+{
+public:
+  using value_type = typename index_traits<Index>::value_type;
+
+public:
+  ParallelDoubling(size_t n, ThreadPool& tp):
+    n_(n), tp_(tp), sa_(n), rank_(n)
+  {}
+
+  template <typename Iter>
+  sa_vector_t<Index> build(Iter first)
+  {
+    // Round 0 sorts every suffix on its first byte
+    recs_.resize(n_);
+    pos_.resize(n_);
+    for_each_block(n_, nblocks(n_), tp_, [&](size_t, size_t b, size_t e) {
+      for (size_t i = b; i < e; i++) {
+        recs_[i] = Rec{0, static_cast<uint8_t>(first[i]), static_cast<value_type>(i)};
+        pos_[i] = static_cast<value_type>(i);
+      }
+    });
+    radix_sort(0, 8);
+    update_groups();
+
+    int bits = 1;
+    while ((uint64_t(1) << bits) <= n_) bits++;
+    for (size_t h = 1; !recs_.empty(); h *= 2) {
+      for_each_block(recs_.size(), nblocks(recs_.size()), tp_, [&](size_t, size_t b, size_t e) {
+        for (size_t k = b; k < e; k++) {
+          size_t i = recs_[k].idx;
+          recs_[k].first = rank_[i];
+          recs_[k].second = i + h < n_ ? rank_[i + h] + 1 : 0;
+        }
+      });
+      radix_sort(bits, bits);
+      update_groups();
+    }
+    return std::move(sa_);
+  }
+
+private:
+  struct Rec {
+    value_type first;
+    value_type second;
+    value_type idx;
+  };
+
+  size_t nblocks(size_t n) const noexcept {
+    return std::max<size_t>(1, std::min(n, tp_.size() * 4));
+  }
+
+  // Stable LSD radix sort of recs_ on (first, second), each of the
+  // given bit width. Wider digits (fewer passes) once the counters
+  // are small next to the data.
+  void radix_sort(int first_bits, int second_bits)
+  {
+    const size_t n = recs_.size();
+    if (n < 2) return;
+    const int digit = n >= (size_t(1) << 22) ? 16 : 11;
+    const size_t radix = size_t(1) << digit;
+    const size_t nb = nblocks(n);
+    tmp_.resize(n);
+    std::vector<size_t> count(nb * radix);
+    Rec* src = recs_.data();
+    Rec* dst = tmp_.data();
+
+    for (int field = 0; field < 2; field++) {
+      const int bits = field == 0 ? second_bits : first_bits;
+      for (int shift = 0; shift < bits; shift += digit) {
+        auto digit_of = [&](const Rec& r) {
+          return static_cast<size_t>(((field == 0 ? r.second : r.first) >> shift) & (radix - 1));
+        };
+
+        std::fill(count.begin(), count.end(), 0);
+        for_each_block(n, nb, tp_, [&](size_t blk, size_t b, size_t e) {
+          size_t* cnt = &count[blk * radix];
+          for (size_t i = b; i < e; i++) cnt[digit_of(src[i])]++;
+        });
+
+        size_t sum = 0;
+        bool trivial = false;
+        for (size_t d = 0; d < radix; d++) {
+          size_t digit_total = 0;
+          for (size_t blk = 0; blk < nb; blk++) {
+            size_t c = count[blk * radix + d];
+            count[blk * radix + d] = sum;
+            sum += c;
+            digit_total += c;
+          }
+          if (digit_total == n) trivial = true;
+        }
+        if (trivial) continue;
+
+        for_each_block(n, nb, tp_, [&](size_t blk, size_t b, size_t e) {
+          size_t* next = &count[blk * radix];
+          for (size_t i = b; i < e; i++) dst[next[digit_of(src[i])]++] = src[i];
+        });
+        std::swap(src, dst);
+      }
+    }
+    if (src != recs_.data()) recs_.swap(tmp_);
+  }
+
+  bool is_head(size_t k) const noexcept {
+    return k == 0 || recs_[k].first != recs_[k - 1].first || recs_[k].second != recs_[k - 1].second;
+  }
+
+  // Places the sorted recs_ at pos_, ranks them by their group head
+  // and keeps only the members of groups still unsorted
+  void update_groups()
+  {
+    const size_t a = recs_.size();
+    const size_t nb = nblocks(a);
+    std::vector<size_t> head(nb), kept(nb + 1, 0);
+
+    // Last group head in each block, or none
+    for_each_block(a, nb, tp_, [&](size_t blk, size_t b, size_t e) {
+      head[blk] = SIZE_MAX;
+      for (size_t k = b; k < e; k++) {
+        if (is_head(k)) head[blk] = k;
+      }
+    });
+    // ... turned into the head in force at the start of each block
+    size_t carry = 0;
+    for (size_t blk = 0; blk < nb; blk++) {
+      size_t last = head[blk];
+      head[blk] = carry;
+      if (last != SIZE_MAX) carry = last;
+    }
+
+    auto singleton = [&](size_t k) { return is_head(k) && (k + 1 == a || is_head(k + 1)); };
+    for_each_block(a, nb, tp_, [&](size_t blk, size_t b, size_t e) {
+      size_t cur = head[blk];
+      size_t count = 0;
+      for (size_t k = b; k < e; k++) {
+        if (is_head(k)) cur = k;
+        rank_[recs_[k].idx] = pos_[cur];
+        sa_[pos_[k]] = recs_[k].idx;
+        count += !singleton(k);
+      }
+      kept[blk + 1] = count;
+    });
+    for (size_t blk = 0; blk < nb; blk++) kept[blk + 1] += kept[blk];
+
+    tmp_.resize(kept[nb]);
+    next_pos_.resize(kept[nb]);
+    for_each_block(a, nb, tp_, [&](size_t blk, size_t b, size_t e) {
+      size_t j = kept[blk];
+      for (size_t k = b; k < e; k++) {
+        if (singleton(k)) continue;
+        tmp_[j] = recs_[k];
+        next_pos_[j++] = pos_[k];
+      }
+    });
+    recs_.swap(tmp_);
+    pos_.swap(next_pos_);
+  }
+
+private:
+  size_t n_;
+  ThreadPool& tp_;
+  sa_vector_t<Index> sa_;
+  std::vector<value_type> rank_;
+  // Suffixes of the unsorted groups, in sa order before sorting
+  std::vector<Rec> recs_;
+  std::vector<Rec> tmp_;
+  // sa positions covered by recs_, ascending
+  std::vector<value_type> pos_;
+  std::vector<value_type> next_pos_;
+};
+
+template <typename Index, typename Iter>
+sa_vector_t<Index> build_suffix_array_impl(Iter first, Iter last, ThreadPool& tp,
+                                           std::random_access_iterator_tag)
+{
+  size_t n = std::distance(first, last);
+  check_text_size<Index>(n);
+  if (n == 0) return sa_vector_t<Index>();
+  return ParallelDoubling<Index>(n, tp).build(first);
+}
+
+template <typename Index, typename Iter>
+sa_vector_t<Index> build_suffix_array_impl(Iter first, Iter last, ThreadPool& tp,
+                                           std::forward_iterator_tag)
+{
+  std::vector<uint8_t> text(first, last);
+  return build_suffix_array_impl<Index>(text.cbegin(), text.cend(), tp,
+                                        std::random_access_iterator_tag());
+}
+
+} // end namespace detail
+
+/*
+ * Multi-threaded suffix array construction by parallel prefix
+ * doubling, O(n log n) work. Same result as qsufsort and sais, for
+ * any Index. Takes about 10 integers (of the computing type of
+ * Index) per input byte while building.
+ */
+template <typename Index = int,
+	 typename Iter, 
+	 typename = typename std::enable_if<
+		      meta::is_one_of<typename std::iterator_traits<Iter>::value_type, uint8_t, char>::value>::type>
+sa_vector_t<Index> build_suffix_array(Iter first, Iter last, ThreadPool& tp)
+{
+  return detail::build_suffix_array_impl<Index>(first, last, tp,
+      typename std::iterator_traits<Iter>::iterator_category());
+}
+
+template <typename Index = int,
+	 typename Iter, 
+	 typename = typename std::enable_if<
+		      meta::is_one_of<typename std::iterator_traits<Iter>::value_type, uint8_t, char>::value>::type>
+sa_vector_t<Index> build_suffix_array(Iter first, Iter last,
+                                      size_t nthreads = std::thread::hardware_concurrency())
+{
+  ThreadPool tp(nthreads);
+  return build_suffix_array<Index>(first, last, tp);
+}
+
+
+/*
+ * LCP array: lcp[i] is the length of the longest common prefix of
+ * the suffixes sa[i - 1] and sa[i], lcp[0] = 0. SAVec is any
+ * sa_vector_t, the result has the same type.
+ *
+ * kasai_lcp     - Kasai et al., linear time. Walks the suffixes in
+ *                 text order, where the common prefix with the
+ *                 suffix ranked just before shrinks by at most one
+ *                 per step. Needs inv, e.g the one qsufsort hands
+ *                 back, so takes sa, inv and lcp at once.
+ * plcp_phi      - Karkkainen, Manzini and Puglisi, "Permuted
+ *                 Longest-Common-Prefix Array". Same walk, but the
+ *                 predecessor of each suffix comes from
+ *                 phi[sa[i]] = sa[i - 1], which is overwritten in
+ *                 place by the lengths. Returns PLCP in text order,
+ *                 lcp[i] == plcp[sa[i]], with only sa and one more
+ *                 array of n alive.
+ * lcp_from_plcp - Turns PLCP into the LCP array.
+ */
+template <typename Iter, typename SAVec>
+SAVec kasai_lcp(Iter first, Iter last, const SAVec& sa, const SAVec& inv)
+{
+  const size_t n = std::distance(first, last);
+  assert (sa.size() == n && inv.size() == n);
+  SAVec lcp(n);
+  size_t h = 0;
+  for (size_t i = 0; i < n; i++) {
+    size_t rank = inv[i];
+    if (rank == 0) {
+      lcp[0] = 0;
+      h = 0;
+      continue;
+    }
+    size_t j = sa[rank - 1];
+    while (i + h < n && j + h < n && first[i + h] == first[j + h]) h++;
+    lcp[rank] = h;
+    if (h > 0) h--;
+  }
+  return lcp;
+}
+
+template <typename Iter, typename SAVec>
+SAVec kasai_lcp(Iter first, Iter last, const SAVec& sa)
+{
+  SAVec inv(sa.size());
+  for (size_t i = 0; i < sa.size(); i++) inv[sa[i]] = i;
+  return kasai_lcp(first, last, sa, inv);
+}
+
+template <typename Iter, typename SAVec>
+SAVec plcp_phi(Iter first, Iter last, const SAVec& sa)
+{
+  const size_t n = std::distance(first, last);
+  assert (sa.size() == n);
+  SAVec plcp(n);
+  if (n == 0) return plcp;
+
+  // phi, with n for the smallest suffix which has no predecessor
+  plcp[sa[0]] = n;
+  for (size_t i = 1; i < n; i++) plcp[sa[i]] = sa[i - 1];
+
+  size_t h = 0;
+  for (size_t i = 0; i < n; i++) {
+    size_t j = plcp[i];
+    if (j == n) {
+      plcp[i] = 0;
+      h = 0;
+      continue;
+    }
+    while (i + h < n && j + h < n && first[i + h] == first[j + h]) h++;
+    plcp[i] = h;
+    if (h > 0) h--;
+  }
+  return plcp;
+}
+
+template <typename SAVec>
+SAVec lcp_from_plcp(const SAVec& sa, const SAVec& plcp)
+{
+  assert (sa.size() == plcp.size());
+  SAVec lcp(sa.size());
+  for (size_t i = 0; i < sa.size(); i++) lcp[i] = plcp[sa[i]];
+  return lcp;
+}
+
 }
 
 #endif
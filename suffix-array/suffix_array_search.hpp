@@ -0,0 +1,642 @@
+#ifndef SUFFIX_ARRAY_SEARCH_HPP
+#define SUFFIX_ARRAY_SEARCH_HPP
+
+#if __cplusplus < 201103L
+#error This header needs atleast a C++11 compliant compiler.
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "suffix_array.hpp"
+#include "../util/mapped_file.hpp"
+#include "../util/thread_pool.hpp"
+
+namespace ds {
+
+namespace detail {
+
+inline void prefetch(const void* p) noexcept
+{
+#if defined(__GNUC__)
+  __builtin_prefetch(p);
+#else
+  (void)p;
+#endif
+}
+
+// Length of the common prefix of a[0..len) and b[0..len).
+// Most probes of a search mismatch in the first bytes, so these are
+// compared alone, then as one 8 byte word, before touching 16 bytes
+// (and maybe a second cache line) of the text. Tails are compared by a last load
+// overlapping what was already compared.
+inline size_t match_length(const uint8_t* a, const uint8_t* b, size_t len) noexcept
+{
+#if defined(__SSE2__)
+  auto word_match = [](const uint8_t* x, const uint8_t* y) -> size_t {
+    uint64_t wx, wy;
+    std::memcpy(&wx, x, sizeof(wx));
+    std::memcpy(&wy, y, sizeof(wy));
+    return wx == wy ? 8 : __builtin_ctzll(wx ^ wy) / 8;
+  };
+  auto block_match = [](const uint8_t* x, const uint8_t* y) -> size_t {
+    __m128i vx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x));
+    __m128i vy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y));
+    unsigned diff = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(vx, vy))) & 0xffff;
+    return diff ? __builtin_ctz(diff) : 16;
+  };
+
+  if (len >= 8) {
+    if (a[0] != b[0]) return 0;
+    size_t k = word_match(a, b);
+    if (k < 8) return k;
+    if (len < 16) return len - 8 + word_match(a + len - 8, b + len - 8);
+    size_t i = 8;
+    for (; i + 16 <= len; i += 16) {
+      k = block_match(a + i, b + i);
+      if (k < 16) return i + k;
+    }
+    return i == len ? len : len - 16 + block_match(a + len - 16, b + len - 16);
+  }
+#endif
+  size_t i = 0;
+  while (i < len && a[i] == b[i]) i++;
+  return i;
+}
+
+template <typename T>
+const void* entry_address(const T* p, size_t i) noexcept { return p + i; }
+
+template <size_t Bytes>
+const void* entry_address(packed_index_ptr<Bytes> p, size_t i) noexcept {
+  return p.entry_address(i);
+}
+
+/*
+ * Fills out[2 * mid] and out[2 * mid + 1] for every midpoint of the
+ * binary search over [lo, hi): the common prefix length of the
+ * suffix at mid with those at lo - 1 and at hi, both 0 past the
+ * ends. Returns min(lcp[lo..hi]) with lcp[n] = 0, i.e the common
+ * prefix of lo - 1 and hi. Recursion depth is log n.
+ */
+template <typename Index>
+size_t fill_search_lcp(typename index_traits<Index>::const_pointer lcp, size_t n,
+                       size_t lo, size_t hi, sa_vector_t<Index>& out)
+{
+  using value_type = typename index_traits<Index>::value_type;
+  if (lo == hi) return hi < n ? static_cast<size_t>(lcp[hi]) : 0;
+  size_t mid = lo + (hi - lo) / 2;
+  size_t left = fill_search_lcp<Index>(lcp, n, lo, mid, out);
+  size_t right = fill_search_lcp<Index>(lcp, n, mid + 1, hi, out);
+  out[2 * mid] = static_cast<value_type>(left);
+  out[2 * mid + 1] = static_cast<value_type>(right);
+  return std::min(left, right);
+}
+
+template <typename Index>
+sa_vector_t<Index> search_lcp(typename index_traits<Index>::const_pointer lcp, size_t n)
+{
+  sa_vector_t<Index> res(2 * n);
+  if (n > 0) fill_search_lcp<Index>(lcp, n, 0, n, res);
+  return res;
+}
+
+/*
+ * Index file layout, host byte order:
+ *   [0, 4096)      IndexFileHeader
+ *   text_offset    text, n bytes
+ *   sa_offset      suffix array, n entries of index_bytes
+ *   lcp_offset     LCP array like sa, or 0 if not stored
+ *   search_lcp_offset
+ *                  2n entries like sa, the per midpoint LCPs of
+ *                  detail::search_lcp; 0 if and only if lcp is
+ * Sections start on 4 KiB boundaries, so each maps onto its own
+ * pages, and are followed by at least 8 bytes of padding for the
+ * word reads of packed entries.
+ */
+struct IndexFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t index_bytes;
+  uint32_t index_signed;
+  uint64_t text_size;
+  uint64_t text_offset;
+  uint64_t sa_offset;
+  uint64_t lcp_offset;
+  uint64_t search_lcp_offset;
+};
+
+static const char index_file_magic[8] = {'d', 's', 'S', 'U', 'F', 'A', 'R', 'R'};
+static const uint32_t index_file_version = 2;
+static const uint32_t index_file_byte_order = 0x01020304;
+static const uint64_t index_file_align = 4096;
+
+inline uint64_t index_file_section_end(uint64_t offset, uint64_t bytes) noexcept
+{
+  uint64_t end = offset + bytes + sizeof(uint64_t);
+  return (end + index_file_align - 1) / index_file_align * index_file_align;
+}
+
+/*
+ * Writes to path + ".tmp" and renames it over path once complete, so
+ * readers never map a partial file.
+ * Throws std::system_error.
+ */
+class IndexFileWriter
+{
+public:
+  explicit IndexFileWriter(const std::string& path):
+    path_(path),
+    tmp_path_(path + ".tmp")
+  {
+    fd_ = ::open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) throw std::system_error(errno, std::generic_category(), tmp_path_);
+  }
+
+  IndexFileWriter(const IndexFileWriter&) = delete;
+  void operator=(const IndexFileWriter&) = delete;
+
+  ~IndexFileWriter() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+      ::unlink(tmp_path_.c_str());
+    }
+  }
+
+public:
+  uint64_t offset() const noexcept { return offset_; }
+
+  void write(const void* data, size_t bytes)
+  {
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+      ssize_t w = ::write(fd_, p, std::min(bytes, size_t(1) << 30));
+      if (w < 0) {
+        if (errno == EINTR) continue;
+        fail();
+      }
+      p += w;
+      bytes -= w;
+      offset_ += w;
+    }
+  }
+
+  // Zeros up to offset `to`
+  void pad(uint64_t to)
+  {
+    static const char zeros[4096] = {0,};
+    while (offset_ < to) write(zeros, std::min<uint64_t>(sizeof(zeros), to - offset_));
+  }
+
+  void commit()
+  {
+    if (::fsync(fd_) < 0) fail();
+    int fd = fd_;
+    fd_ = -1;
+    if (::close(fd) < 0 || ::rename(tmp_path_.c_str(), path_.c_str()) < 0) {
+      int err = errno;
+      ::unlink(tmp_path_.c_str());
+      throw std::system_error(err, std::generic_category(), path_);
+    }
+  }
+
+private:
+  [[noreturn]] void fail() {
+    throw std::system_error(errno, std::generic_category(), tmp_path_);
+  }
+
+private:
+  std::string path_;
+  std::string tmp_path_;
+  int fd_ = -1;
+  uint64_t offset_ = 0;
+};
+
+} // end namespace detail
+
+/*
+ * @class SuffixArray
+ * Substring index over a byte text: the text with its suffix array,
+ * and optionally its LCP array.
+ *
+ * Searches are binary searches over sa that keep the length of the
+ * match with the suffixes at both ends of the range (llcp, rlcp),
+ * and compare 16 bytes at a time with SSE2.
+ * - With an LCP array, Manber and Myers' mm/lcp search: the common
+ *   prefix of each midpoint with both ends of its range is stored
+ *   (detail::search_lcp, 2n more entries), so a probe either
+ *   decides from it without reading the text, or compares starting
+ *   at max(llcp, rlcp). Matched bytes are never compared again:
+ *   O(m + log n) per search, whatever the text.
+ * - Without, the mlr accelerant: comparisons start past the
+ *   min(llcp, rlcp) bytes every suffix of the range shares with
+ *   the pattern. O(m + log n) on random like texts, O(m log n)
+ *   when long repeats keep llcp and rlcp apart.
+ *
+ * Batches run groups of searches in lockstep: each round first
+ * prefetches the sa entry (and midpoint LCPs) of every search in
+ * the group, then the text at those entries, then compares, so the
+ * cache misses of the group overlap instead of following one
+ * another.
+ *
+ * save() writes the index to a versioned file with page aligned
+ * sections (see detail::IndexFileHeader). open() maps such a file
+ * read only and searches it in place: startup only checks the
+ * header, the pages a search touches are read on demand and shared
+ * through the page cache by every process mapping the file.
+ * The sections themselves are trusted, not validated.
+ *
+ * Exposed API's:
+ * 1. SuffixArray(first, last)   - Copies the text, builds with sais.
+ *    SuffixArray(text, sa[, lcp]) - Adopts a text and its arrays.
+ * 2. open(path)                 - Index mapped from a file written by
+ *                                 save(). Throws std::system_error if
+ *                                 it cannot be mapped, and
+ *                                 std::runtime_error if it is not an
+ *                                 index of this Index type.
+ * 3. save(path)                 - Writes the index, replacing path
+ *                                 atomically. Throws std::system_error.
+ * 4. equal_range(pattern)       - [begin, end) of the sa positions of
+ *                                 the suffixes starting with pattern.
+ * 5. count(pattern)             - Number of occurrences.
+ * 6. locate(pattern)            - Text positions of the occurrences,
+ *                                 in suffix order.
+ * 7. batch_locate(patterns, tp) - locate of every pattern, split over
+ *                                 the thread pool.
+ * 8. size(), text(), suffix_array(), has_lcp(), lcp() - The arrays
+ *    are index_traits<Index>::const_pointer views.
+ */
+template <typename Index = int>
+class SuffixArray
+{
+public:
+  using value_type = typename index_traits<Index>::value_type;
+  using const_pointer = typename index_traits<Index>::const_pointer;
+  using range_type = std::pair<size_t, size_t>;
+
+public:
+  template <typename Iter>
+  SuffixArray(Iter first, Iter last):
+    text_store_(first, last),
+    sa_store_(sais<Index>(text_store_.cbegin(), text_store_.cend()))
+  {
+    adopt_stores();
+  }
+
+  SuffixArray(std::vector<uint8_t> text, sa_vector_t<Index> sa,
+              sa_vector_t<Index> lcp = sa_vector_t<Index>()):
+    text_store_(std::move(text)),
+    sa_store_(std::move(sa)),
+    lcp_store_(std::move(lcp))
+  {
+    assert (text_store_.size() == sa_store_.size());
+    assert (lcp_store_.size() == 0 || lcp_store_.size() == sa_store_.size());
+    if (lcp_store_.size() != 0) {
+      search_lcp_store_ = detail::search_lcp<Index>(index_traits<Index>::view(lcp_store_),
+                                                    lcp_store_.size());
+    }
+    adopt_stores();
+  }
+
+  SuffixArray(const SuffixArray&) = delete;
+  void operator=(const SuffixArray&) = delete;
+  // The views point into the moved buffers, which stay put
+  SuffixArray(SuffixArray&&) = default;
+
+  static SuffixArray open(const std::string& path)
+  {
+    using traits = index_traits<Index>;
+    std::unique_ptr<MappedFile> file(new MappedFile(path, MADV_RANDOM));
+    auto bad = [&](const char* what) { return std::runtime_error(path + ": " + what); };
+
+    detail::IndexFileHeader h;
+    if (file->size() < sizeof(h)) throw bad("not a suffix array index");
+    std::memcpy(&h, file->data(), sizeof(h));
+    if (std::memcmp(h.magic, detail::index_file_magic, sizeof(h.magic)) != 0) {
+      throw bad("not a suffix array index");
+    }
+    if (h.version != detail::index_file_version) throw bad("unsupported index version");
+    if (h.byte_order != detail::index_file_byte_order) throw bad("index of another byte order");
+    if (h.index_bytes != traits::bytes ||
+        h.index_signed != static_cast<uint32_t>(std::is_signed<value_type>::value)) {
+      throw bad("index of another Index type");
+    }
+    if (h.text_size >= static_cast<uint64_t>(traits::max())) throw bad("corrupt header");
+
+    // Every section inside the file, page aligned, with its padding
+    const uint64_t n = h.text_size;
+    auto fits = [&](uint64_t offset, uint64_t bytes) {
+      return offset >= sizeof(h) && offset % detail::index_file_align == 0 &&
+             offset <= file->size() && bytes <= file->size() - offset &&
+             file->size() - offset - bytes >= sizeof(uint64_t);
+    };
+    if (!fits(h.text_offset, n) || !fits(h.sa_offset, n * traits::bytes) ||
+        (h.lcp_offset != 0) != (h.search_lcp_offset != 0) ||
+        (h.lcp_offset != 0 && !fits(h.lcp_offset, n * traits::bytes)) ||
+        (h.search_lcp_offset != 0 && !fits(h.search_lcp_offset, 2 * n * traits::bytes))) {
+      throw bad("corrupt header");
+    }
+
+    SuffixArray res;
+    auto base = reinterpret_cast<const uint8_t*>(file->data());
+    res.n_ = n;
+    res.text_ = base + h.text_offset;
+    res.sa_ = traits::view(base + h.sa_offset);
+    res.has_lcp_ = h.lcp_offset != 0;
+    if (res.has_lcp_) {
+      res.lcp_ = traits::view(base + h.lcp_offset);
+      res.search_lcp_ = traits::view(base + h.search_lcp_offset);
+    }
+    res.file_ = std::move(file);
+    return res;
+  }
+
+  void save(const std::string& path) const
+  {
+    using traits = index_traits<Index>;
+    const uint64_t bytes = n_ * traits::bytes;
+    detail::IndexFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, detail::index_file_magic, sizeof(h.magic));
+    h.version = detail::index_file_version;
+    h.byte_order = detail::index_file_byte_order;
+    h.index_bytes = traits::bytes;
+    h.index_signed = std::is_signed<value_type>::value;
+    h.text_size = n_;
+    h.text_offset = detail::index_file_align;
+    h.sa_offset = detail::index_file_section_end(h.text_offset, n_);
+    uint64_t end = detail::index_file_section_end(h.sa_offset, bytes);
+    if (has_lcp_) {
+      h.lcp_offset = end;
+      h.search_lcp_offset = detail::index_file_section_end(h.lcp_offset, bytes);
+      end = detail::index_file_section_end(h.search_lcp_offset, 2 * bytes);
+    }
+
+    detail::IndexFileWriter out(path);
+    out.write(&h, sizeof(h));
+    out.pad(h.text_offset);
+    out.write(text_, n_);
+    out.pad(h.sa_offset);
+    out.write(detail::entry_address(sa_, 0), bytes);
+    if (has_lcp_) {
+      out.pad(h.lcp_offset);
+      out.write(detail::entry_address(lcp_, 0), bytes);
+      out.pad(h.search_lcp_offset);
+      out.write(detail::entry_address(search_lcp_, 0), 2 * bytes);
+    }
+    out.pad(end);
+    out.commit();
+  }
+
+public:
+  size_t size() const noexcept { return n_; }
+  const uint8_t* text() const noexcept { return text_; }
+  const_pointer suffix_array() const noexcept { return sa_; }
+  bool has_lcp() const noexcept { return has_lcp_; }
+  const_pointer lcp() const noexcept { return lcp_; }
+
+  range_type equal_range(const std::string& pattern) const noexcept
+  {
+    Search lower(pattern, false, size());
+    run(&lower, 1);
+    Search upper(pattern, true, lower);
+    run(&upper, 1);
+    return range_type(lower.lo, upper.lo);
+  }
+
+  size_t count(const std::string& pattern) const noexcept
+  {
+    auto r = equal_range(pattern);
+    return r.second - r.first;
+  }
+
+  std::vector<value_type> locate(const std::string& pattern) const
+  {
+    return positions(equal_range(pattern));
+  }
+
+  std::vector<std::vector<value_type>> batch_locate(const std::vector<std::string>& patterns,
+                                                     ThreadPool& tp) const
+  {
+    std::vector<std::vector<value_type>> res(patterns.size());
+    tp.parallel_for(0, patterns.size(), [&](size_t b, size_t e) {
+      std::vector<Search> lower, upper;
+      for (size_t g = b; g < e; g += group_size) {
+        size_t ge = std::min(e, g + group_size);
+        lower.clear();
+        upper.clear();
+        for (size_t q = g; q < ge; q++) lower.emplace_back(patterns[q], false, size());
+        run(lower.data(), lower.size());
+        for (size_t q = g; q < ge; q++) upper.emplace_back(patterns[q], true, lower[q - g]);
+        run(upper.data(), upper.size());
+        for (size_t q = g; q < ge; q++) {
+          res[q] = positions(range_type(lower[q - g].lo, upper[q - g].lo));
+        }
+      }
+    });
+    return res;
+  }
+
+private:
+  SuffixArray() = default;
+
+  void adopt_stores() noexcept
+  {
+    n_ = text_store_.size();
+    text_ = text_store_.data();
+    sa_ = index_traits<Index>::view(sa_store_);
+    has_lcp_ = lcp_store_.size() != 0;
+    lcp_ = index_traits<Index>::view(lcp_store_);
+    search_lcp_ = index_traits<Index>::view(search_lcp_store_);
+  }
+
+private:
+  // Searches run in lockstep per thread
+  static const size_t group_size = 8;
+
+  /*
+   * Binary search for the first suffix in [lo, hi) that is not
+   * smaller than the pattern (lower), or not smaller and not
+   * starting with it (upper). llcp and rlcp are the matched lengths
+   * with the suffixes at lo - 1 and hi.
+   * Both searches take the same path up to the first suffix that
+   * starts with the pattern. The lower search keeps the state the
+   * upper one has right after it (fork_*), a range of the same
+   * search tree, so the upper search resumes from there.
+   */
+  struct Search {
+    Search(const std::string& p, bool upper_bound, size_t n):
+      pat(reinterpret_cast<const uint8_t*>(p.data())), m(p.size()), upper(upper_bound),
+      lo(0), hi(n)
+    {}
+
+    // Upper search over what the lower search left open
+    Search(const std::string& p, bool upper_bound, const Search& lower):
+      pat(reinterpret_cast<const uint8_t*>(p.data())), m(p.size()), upper(upper_bound),
+      lo(lower.forked ? lower.fork_lo : lower.lo),
+      hi(lower.forked ? lower.fork_hi : lower.lo),
+      llcp(lower.m), rlcp(lower.fork_rlcp)
+    {}
+
+    const uint8_t* pat;
+    size_t m;
+    bool upper;
+    size_t lo, hi;
+    size_t llcp = 0, rlcp = 0;
+    bool forked = false;
+    size_t fork_lo = 0, fork_hi = 0, fork_rlcp = 0;
+    size_t mid = 0;
+    // Whether the last probe read the text
+    bool compared = true;
+  };
+
+  // Pattern offset the comparison of a probe starts at
+  size_t compare_from(const Search& s) const noexcept
+  {
+    return has_lcp_ ? std::max(s.llcp, s.rlcp) : std::min(s.llcp, s.rlcp);
+  }
+
+  // Matched length of the pattern with the suffix at pos, past the
+  // first k bytes known to match. Kept out of line so that probe
+  // inlines into the search loops and their state stays in registers
+#if defined(__GNUC__)
+  __attribute__((noinline))
+#endif
+  size_t extend_match(const uint8_t* pat, size_t m, size_t pos, size_t k) const noexcept
+  {
+    size_t len = std::min(m, n_ - pos);
+    return k + detail::match_length(pat + k, text_ + pos + k, len - k);
+  }
+
+  // Decides which half of the range holds the answer from the
+  // suffix at sa[s.mid] and halves the range
+  void probe(Search& s) const noexcept
+  {
+    // mm/lcp: l, the common prefix of mid with the end of the range
+    // matching more of the pattern, decides the probe unless it
+    // equals that match. mlr: always compare past min(llcp, rlcp)
+    bool right = false;
+    bool decided = false;
+    size_t k = std::min(s.llcp, s.rlcp);
+    if (has_lcp_) {
+      bool from_left = s.llcp >= s.rlcp;
+      size_t known = from_left ? s.llcp : s.rlcp;
+      size_t l = static_cast<size_t>(search_lcp_[2 * s.mid + !from_left]);
+      decided = l != known;
+      right = (l > known) == from_left;
+      k = std::min(l, known);
+    }
+    s.compared = !decided;
+    if (!decided) {
+      size_t pos = sa_[s.mid];
+      k = extend_match(s.pat, s.m, pos, k);
+      right = k == s.m ? s.upper : (pos + k == n_ || text_[pos + k] < s.pat[k]);
+    }
+
+    if (!right && k == s.m && !s.forked) {
+      s.forked = true;
+      s.fork_lo = s.mid + 1;
+      s.fork_hi = s.hi;
+      s.fork_rlcp = s.rlcp;
+    }
+    if (right) {
+      s.lo = s.mid + 1;
+      s.llcp = k;
+    } else {
+      s.hi = s.mid;
+      s.rlcp = k;
+    }
+  }
+
+  void run(Search* group, size_t count) const noexcept
+  {
+    if (count == 1) {
+      // A local copy stays in registers. The entries both possible
+      // next probes read first are prefetched while this one
+      // compares; with mm/lcp, that is the text only after a probe
+      // that needed it, as decided probes tend to come in runs
+      Search s = *group;
+      while (s.lo < s.hi) {
+        s.mid = s.lo + (s.hi - s.lo) / 2;
+        size_t next_left = s.lo + (s.mid - s.lo) / 2;
+        size_t next_right = s.mid + 1 + (s.hi - s.mid - 1) / 2;
+        if (has_lcp_) {
+          detail::prefetch(detail::entry_address(search_lcp_, 2 * next_left));
+          detail::prefetch(detail::entry_address(search_lcp_, 2 * next_right));
+        }
+        if (!has_lcp_ || s.compared) {
+          detail::prefetch(detail::entry_address(sa_, next_left));
+          detail::prefetch(detail::entry_address(sa_, next_right));
+          detail::prefetch(text_ + sa_[s.mid] + compare_from(s));
+        }
+        probe(s);
+      }
+      *group = s;
+      return;
+    }
+
+    bool active = true;
+    while (active) {
+      active = false;
+      for (size_t q = 0; q < count; q++) {
+        Search& s = group[q];
+        if (s.lo >= s.hi) continue;
+        s.mid = s.lo + (s.hi - s.lo) / 2;
+        detail::prefetch(detail::entry_address(sa_, s.mid));
+        if (has_lcp_) detail::prefetch(detail::entry_address(search_lcp_, 2 * s.mid));
+      }
+      for (size_t q = 0; q < count; q++) {
+        Search& s = group[q];
+        if (s.lo >= s.hi) continue;
+        detail::prefetch(text_ + sa_[s.mid] + compare_from(s));
+      }
+      for (size_t q = 0; q < count; q++) {
+        Search& s = group[q];
+        if (s.lo >= s.hi) continue;
+        probe(s);
+        active |= s.lo < s.hi;
+      }
+    }
+  }
+
+  std::vector<value_type> positions(range_type r) const
+  {
+    std::vector<value_type> res;
+    res.reserve(r.second - r.first);
+    for (size_t i = r.first; i < r.second; i++) res.push_back(sa_[i]);
+    return res;
+  }
+
+private:
+  // Owned arrays, empty when mapped from a file
+  std::vector<uint8_t> text_store_;
+  sa_vector_t<Index> sa_store_;
+  sa_vector_t<Index> lcp_store_;
+  sa_vector_t<Index> search_lcp_store_;
+  std::unique_ptr<MappedFile> file_;
+
+  // What searches read, into the stores or the mapping
+  const uint8_t* text_ = nullptr;
+  size_t n_ = 0;
+  const_pointer sa_ = index_traits<Index>::view(nullptr);
+  const_pointer lcp_ = index_traits<Index>::view(nullptr);
+  const_pointer search_lcp_ = index_traits<Index>::view(nullptr);
+  bool has_lcp_ = false;
+};
+
+}
+#endif
@@ -1,11 +1,547 @@
 #include "suffix_array.hpp"
+#include "suffix_array_search.hpp"
+#include "fm_index.hpp"
+#include "external_suffix_array.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <system_error>
 
 using namespace ds;
 
-int main() {
+// Suffix array by plain comparison sort
+std::vector<int> naive_suffix_array(const std::string& s)
+{
+  std::vector<int> sa(s.size());
+  for (size_t i = 0; i < sa.size(); i++) sa[i] = i;
+  std::sort(sa.begin(), sa.end(), [&s](int a, int b) {
+    return s.compare(a, std::string::npos, s, b, std::string::npos) < 0;
+  });
+  return sa;
+}
+
+void test_qsufsort_simple()
+{
   std::string s("abcabc");
-  std::cout << s << std::endl;
-  auto c = qsufsort(s.begin(), s.end());
+  auto sa = qsufsort(s.begin(), s.end());
+  std::vector<int> expect{3, 0, 4, 1, 5, 2};
+  assert (sa == expect);
+
+  std::string banana("banana");
+  sa = qsufsort(banana.begin(), banana.end());
+  expect = {5, 3, 1, 0, 4, 2};
+  assert (sa == expect);
+
+  std::string empty;
+  assert (qsufsort(empty.begin(), empty.end()).empty());
+  std::string one("x");
+  assert (qsufsort(one.begin(), one.end()) == std::vector<int>{0});
+}
+
+void test_qsufsort_random()
+{
+  std::mt19937 gen(7);
+  for (int alphabet : {1, 2, 4, 26}) {
+    std::uniform_int_distribution<int> dist(0, alphabet - 1);
+    for (int len : {2, 3, 7, 8, 41, 100, 1000, 5000}) {
+      std::string s(len, 'a');
+      for (auto& c : s) c = 'a' + dist(gen);
+      assert (qsufsort(s.begin(), s.end()) == naive_suffix_array(s));
+    }
+  }
+
+  // Highly repetitive input needs the most doubling rounds
+  std::string fib_prev("b"), fib("a");
+  while (fib.size() < 3000) {
+    auto next = fib + fib_prev;
+    fib_prev = fib;
+    fib = next;
+  }
+  assert (qsufsort(fib.begin(), fib.end()) == naive_suffix_array(fib));
+}
+
+void test_sais()
+{
+  std::string banana("banana");
+  std::vector<int> expect{5, 3, 1, 0, 4, 2};
+  assert (sais(banana.begin(), banana.end()) == expect);
+  std::string empty;
+  assert (sais(empty.begin(), empty.end()).empty());
+
+  std::mt19937 gen(11);
+  for (int alphabet : {1, 2, 3, 26, 256}) {
+    std::uniform_int_distribution<int> dist(0, alphabet - 1);
+    for (int len : {1, 2, 3, 5, 17, 100, 1000, 5000}) {
+      std::vector<uint8_t> text(len);
+      for (auto& c : text) c = static_cast<uint8_t>(dist(gen));
+      std::string s(text.begin(), text.end());
+      // Reference on the unsigned bytes
+      std::vector<int> ref(len);
+      for (int i = 0; i < len; i++) ref[i] = i;
+      std::sort(ref.begin(), ref.end(), [&text](int a, int b) {
+        return std::lexicographical_compare(text.begin() + a, text.end(), text.begin() + b, text.end());
+      });
+      assert (sais(text.begin(), text.end()) == ref);
+      assert (sais(s.begin(), s.end()) == ref);
+    }
+  }
+
+  // Recursion several levels deep, and a non random access input
+  std::string fib_prev("b"), fib("a");
+  while (fib.size() < 3000) {
+    auto next = fib + fib_prev;
+    fib_prev = fib;
+    fib = next;
+  }
+  assert (sais(fib.begin(), fib.end()) == qsufsort(fib.begin(), fib.end()));
+  std::list<char> fib_list(fib.begin(), fib.end());
+  assert (sais(fib_list.begin(), fib_list.end()) == naive_suffix_array(fib));
+}
+
+void test_build_suffix_array()
+{
+  std::string banana("banana");
+  std::vector<int> expect{5, 3, 1, 0, 4, 2};
+  assert (build_suffix_array(banana.begin(), banana.end(), 2) == expect);
+  std::string empty;
+  assert (build_suffix_array(empty.begin(), empty.end(), 2).empty());
+
+  std::mt19937 gen(5);
+  std::string fib_prev("b"), fib("a");
+  while (fib.size() < 20000) {
+    auto next = fib + fib_prev;
+    fib_prev = fib;
+    fib = next;
+  }
+  for (size_t nthreads : {1, 2, 4}) {
+    ThreadPool tp(nthreads);
+    for (int alphabet : {1, 2, 4, 256}) {
+      std::uniform_int_distribution<int> dist(0, alphabet - 1);
+      for (int len : {1, 2, 9, 100, 5000, 30000}) {
+        std::vector<uint8_t> text(len);
+        for (auto& c : text) c = static_cast<uint8_t>(dist(gen));
+        assert (build_suffix_array(text.begin(), text.end(), tp) == sais(text.begin(), text.end()));
+      }
+    }
+    assert (build_suffix_array(fib.begin(), fib.end(), tp) == sais(fib.begin(), fib.end()));
+  }
+  std::list<char> banana_list(banana.begin(), banana.end());
+  assert (build_suffix_array(banana_list.begin(), banana_list.end(), 3) == expect);
+}
+
+template <typename Vec>
+bool same_entries(const Vec& sa, const std::vector<int>& expect)
+{
+  if (sa.size() != expect.size()) return false;
+  for (size_t i = 0; i < sa.size(); i++) {
+    if (static_cast<uint64_t>(sa[i]) != static_cast<uint64_t>(expect[i])) return false;
+  }
+  return true;
+}
+
+void test_index_types()
+{
+  packed_index_vector<5> packed(3);
+  packed[0] = (uint64_t(1) << 40) - 2;
+  packed[1] = 0x0102030405;
+  packed[2] = packed[0];
+  const auto& cpacked = packed;
+  assert (cpacked[0] == (uint64_t(1) << 40) - 2 && cpacked[1] == 0x0102030405 && cpacked[2] == cpacked[0]);
+
+  // Bytes above 0x7f sort after ASCII also through a signed char
+  std::string high("a\xff" "b\x80" "a\xff" "a");
+  std::vector<uint8_t> bytes(high.begin(), high.end());
+  auto expect = naive_suffix_array(std::string(bytes.begin(), bytes.end()));
+  std::sort(expect.begin(), expect.end(), [&bytes](int a, int b) {
+    return std::lexicographical_compare(bytes.begin() + a, bytes.end(), bytes.begin() + b, bytes.end());
+  });
+  assert (qsufsort(high.begin(), high.end()) == expect);
+  assert (sais(high.begin(), high.end()) == expect);
+  assert (build_suffix_array(high.begin(), high.end(), 2) == expect);
+
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<int> dist(0, 3);
+  std::string s(4000, 'a');
+  for (auto& c : s) c = 'a' + dist(gen);
+  expect = naive_suffix_array(s);
+
+  ThreadPool tp(2);
+  assert (same_entries(qsufsort<int64_t>(s.begin(), s.end()), expect));
+  assert (same_entries(sais<uint32_t>(s.begin(), s.end()), expect));
+  assert (same_entries(sais<uint64_t>(s.begin(), s.end()), expect));
+  assert (same_entries(sais<uint40>(s.begin(), s.end()), expect));
+  assert (same_entries(build_suffix_array<uint32_t>(s.begin(), s.end(), tp), expect));
+  assert (same_entries(build_suffix_array<uint40>(s.begin(), s.end(), tp), expect));
+
+  // Too long for the index type
+  std::string long_text(300, 'a');
+  bool thrown = false;
+  try {
+    sais<uint8_t>(long_text.begin(), long_text.end());
+  } catch (const std::length_error&) {
+    thrown = true;
+  }
+  assert (thrown);
+  assert (same_entries(sais<uint16_t>(long_text.begin(), long_text.end()), naive_suffix_array(long_text)));
+}
+
+void test_lcp()
+{
+  std::string banana("banana");
+  std::vector<int> inv;
+  auto sa = qsufsort(banana.begin(), banana.end(), inv);
+  for (int i = 0; i < 6; i++) assert (inv[sa[i]] == i);
+  std::vector<int> expect{0, 1, 3, 0, 0, 2};
+  assert (kasai_lcp(banana.begin(), banana.end(), sa, inv) == expect);
+  assert (lcp_from_plcp(sa, plcp_phi(banana.begin(), banana.end(), sa)) == expect);
+
+  std::mt19937 gen(17);
+  for (int alphabet : {1, 2, 4, 26}) {
+    std::uniform_int_distribution<int> dist(0, alphabet - 1);
+    for (int len : {0, 1, 2, 50, 2000}) {
+      std::string s(len, 'a');
+      for (auto& c : s) c = 'a' + dist(gen);
+      sa = qsufsort(s.begin(), s.end(), inv);
+
+      std::vector<int> naive(len, 0);
+      for (int i = 1; i < len; i++) {
+        int a = sa[i - 1], b = sa[i];
+        while (std::max(a, b) + naive[i] < len && s[a + naive[i]] == s[b + naive[i]]) naive[i]++;
+      }
+      assert (kasai_lcp(s.begin(), s.end(), sa, inv) == naive);
+      assert (kasai_lcp(s.begin(), s.end(), sa) == naive);
+      auto plcp = plcp_phi(s.begin(), s.end(), sa);
+      for (int i = 0; i < len; i++) assert (plcp[sa[i]] == naive[i]);
+      assert (lcp_from_plcp(sa, plcp) == naive);
+
+      auto packed = sais<uint40>(s.begin(), s.end());
+      assert (same_entries(lcp_from_plcp(packed, plcp_phi(s.begin(), s.end(), packed)), naive));
+
+      // Distinct substrings: all prefixes of all suffixes, minus repeats
+      if (len <= 50) {
+        std::set<std::string> subs;
+        for (int i = 0; i < len; i++) {
+          for (int l = 1; i + l <= len; l++) subs.insert(s.substr(i, l));
+        }
+        long distinct = long(len) * (len + 1) / 2;
+        for (auto l : naive) distinct -= l;
+        assert (distinct == static_cast<long>(subs.size()));
+      }
+    }
+  }
+}
+
+// Start positions of pattern in text, ascending
+std::vector<uint64_t> naive_find_all(const std::string& text, const std::string& pattern)
+{
+  std::vector<uint64_t> res;
+  for (size_t i = 0; i < text.size() && i + pattern.size() <= text.size(); i++) {
+    if (text.compare(i, pattern.size(), pattern) == 0) res.push_back(i);
+  }
+  return res;
+}
+
+// Searches with mlr (no LCP) and with mm/lcp against brute force
+template <typename Index>
+void check_search(const std::string& text, const std::vector<std::string>& patterns)
+{
+  SuffixArray<Index> mlr(text.begin(), text.end());
+  std::vector<uint8_t> bytes(text.begin(), text.end());
+  auto sa = sais<Index>(bytes.begin(), bytes.end());
+  auto lcp = kasai_lcp(bytes.begin(), bytes.end(), sa);
+  SuffixArray<Index> mm(std::move(bytes), std::move(sa), std::move(lcp));
+  ThreadPool tp(3);
+
+  for (const SuffixArray<Index>* index : {&mlr, &mm}) {
+    auto batch = index->batch_locate(patterns, tp);
+    assert (batch.size() == patterns.size());
+
+    for (size_t q = 0; q < patterns.size(); q++) {
+      auto expect = naive_find_all(text, patterns[q]);
+      assert (index->count(patterns[q]) == expect.size());
+
+      auto found = index->locate(patterns[q]);
+      assert (found == batch[q]);
+      std::vector<uint64_t> sorted(found.begin(), found.end());
+      std::sort(sorted.begin(), sorted.end());
+      assert (sorted == expect);
+    }
+  }
+}
+
+void test_search()
+{
+  std::string banana("banana");
+  SuffixArray<> index(banana.begin(), banana.end());
+  assert (index.count("ana") == 2 && index.count("a") == 3 && index.count("") == 6);
+  assert (index.count("nab") == 0 && index.count("bananas") == 0 && index.count("x") == 0);
+  auto r = index.equal_range("an");
+  assert (r.first == 1 && r.second == 3);
+  assert (index.locate("na") == (std::vector<int>{4, 2}));
+
+  std::mt19937 gen(23);
+  for (int alphabet : {2, 4, 26}) {
+    std::uniform_int_distribution<int> dist(0, alphabet - 1);
+    std::string text(3000, 'a');
+    for (auto& c : text) c = 'a' + dist(gen);
+    // A long repeat to get past the 16 byte compare blocks
+    text += text.substr(100, 200) + text.substr(100, 150);
+
+    std::vector<std::string> patterns{"", text, text + "a"};
+    std::uniform_int_distribution<size_t> pos(0, text.size() - 1);
+    for (int q = 0; q < 200; q++) {
+      size_t p = pos(gen);
+      size_t len = std::min(text.size() - p, size_t(1) + gen() % (q % 4 ? 8 : 300));
+      patterns.push_back(text.substr(p, len));
+      std::string random(1 + gen() % 6, 'a');
+      for (auto& c : random) c = 'a' + dist(gen);
+      patterns.push_back(random);
+    }
+    check_search<int>(text, patterns);
+    check_search<uint40>(text, patterns);
+  }
+
+  // Long repeats everywhere, where llcp and rlcp drift apart
+  std::string prev("b"), fib("a");
+  while (fib.size() < 5000) {
+    auto next = fib + prev;
+    prev.swap(fib);
+    fib.swap(next);
+  }
+  std::string periodic;
+  while (periodic.size() < 3000) periodic += "abaababaab";
+  periodic += "c" + periodic.substr(0, 1000);
+  for (const auto& text : {fib, periodic}) {
+    std::vector<std::string> patterns{"", text, text + "a", text.substr(1)};
+    for (int q = 0; q < 150; q++) {
+      size_t p = gen() % text.size();
+      std::string pattern = text.substr(p, 1 + gen() % (q % 3 ? 40 : 1500));
+      patterns.push_back(pattern);
+      // Mismatch at the last byte, past a long match
+      pattern.back() = pattern.back() == 'a' ? 'b' : 'a';
+      patterns.push_back(pattern);
+    }
+    check_search<int>(text, patterns);
+    check_search<uint40>(text, patterns);
+  }
+}
+
+template <typename Index>
+void check_index_file(const std::string& text, bool with_lcp)
+{
+  const std::string path = "test_index_file.tmp";
+  std::vector<uint8_t> bytes(text.begin(), text.end());
+  auto sa = sais<Index>(bytes.begin(), bytes.end());
+  sa_vector_t<Index> lcp;
+  if (with_lcp) lcp = kasai_lcp(bytes.begin(), bytes.end(), sa);
+  auto expect_lcp = lcp;
+  SuffixArray<Index> built(bytes, sa, std::move(lcp));
+  built.save(path);
+
+  auto index = SuffixArray<Index>::open(path);
+  assert (index.size() == text.size() && index.has_lcp() == with_lcp);
+  assert (std::equal(bytes.begin(), bytes.end(), index.text()));
+  for (size_t i = 0; i < text.size(); i++) {
+    assert (index.suffix_array()[i] == sa[i]);
+    if (with_lcp) assert (index.lcp()[i] == expect_lcp[i]);
+  }
+  for (size_t len = 1; len <= 4 && len <= text.size(); len++) {
+    std::string pattern = text.substr(text.size() / 3, len);
+    assert (index.locate(pattern) == built.locate(pattern));
+  }
+
+  // The mapping outlives a move, and the file can be saved again
+  SuffixArray<Index> moved(std::move(index));
+  moved.save(path);
+  auto again = SuffixArray<Index>::open(path);
+  assert (again.count(text.substr(0, 1)) == built.count(text.substr(0, 1)));
+  std::remove(path.c_str());
+}
+
+void test_index_file()
+{
+  std::string text(5000, 'a');
+  std::mt19937 gen(29);
+  for (auto& c : text) c = 'a' + gen() % 3;
+  check_index_file<int>(text, true);
+  check_index_file<int>(text, false);
+  check_index_file<uint40>(text, true);
+  check_index_file<uint32_t>("banana", true);
+  check_index_file<int>("", false);
+
+  const std::string path = "test_index_file.tmp";
+  SuffixArray<> index(text.begin(), text.end());
+  index.save(path);
+
+  // Another Index type, a truncated file and a missing one
+  bool thrown = false;
+  try { SuffixArray<uint40>::open(path); } catch (const std::runtime_error&) { thrown = true; }
+  assert (thrown);
+
+  std::string head;
+  {
+    std::ifstream in(path, std::ios::binary);
+    head.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << head.substr(0, head.size() / 2);
+  thrown = false;
+  try { SuffixArray<>::open(path); } catch (const std::runtime_error&) { thrown = true; }
+  assert (thrown);
+
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << "not an index";
+  thrown = false;
+  try { SuffixArray<>::open(path); } catch (const std::runtime_error&) { thrown = true; }
+  assert (thrown);
+
+  std::remove(path.c_str());
+  thrown = false;
+  try { SuffixArray<>::open(path); } catch (const std::system_error&) { thrown = true; }
+  assert (thrown);
+}
+
+template <typename Index>
+void check_fm_index(const std::string& text, const std::vector<std::string>& patterns,
+                    size_t sample_rate)
+{
+  auto sa = sais<Index>(text.begin(), text.end());
+  FMIndex<Index> fm(text.begin(), text.end(), sa, sample_rate);
+  SuffixArray<Index> index(text.begin(), text.end());
+  assert (fm.size() == text.size());
+  for (auto& p : patterns) {
+    assert (fm.count(p) == index.count(p));
+    assert (fm.locate(p) == index.locate(p));
+  }
+}
+
+void test_fm_index()
+{
+  std::string text("banana");
+  FMIndex<> fm(text.begin(), text.end(), 2);
+  assert (fm.count("ana") == 2 && fm.count("a") == 3 && fm.count("") == 6);
+  assert (fm.count("nab") == 0 && fm.count("bananas") == 0 && fm.count("x") == 0);
+  assert (fm.locate("na") == (std::vector<int>{4, 2}));
+  assert (fm.locate("banana") == (std::vector<int>{0}));
+
+  std::mt19937 gen(31);
+  for (int alphabet : {1, 2, 4, 26, 256}) {
+    std::string text(4000, 'a');
+    for (auto& c : text) c = static_cast<char>('a' + gen() % alphabet);
+    text += text.substr(10, 500);
+
+    std::vector<std::string> patterns{"", text, std::string(1, '\0'), std::string(3, 'a')};
+    for (int q = 0; q < 100; q++) {
+      size_t p = gen() % text.size();
+      patterns.push_back(text.substr(p, 1 + gen() % (q % 3 ? 6 : 100)));
+      std::string random(1 + gen() % 4, 'a');
+      for (auto& c : random) c = static_cast<char>('a' + gen() % alphabet);
+      patterns.push_back(random);
+    }
+    for (size_t rate : {1, 3, 32}) check_fm_index<int>(text, patterns, rate);
+    check_fm_index<uint40>(text, patterns, 7);
+  }
+  check_fm_index<int>("", {"", "a"}, 4);
+  check_fm_index<int64_t>("mississippi", {"ssi", "i", "pp", "issip", "m", "mississippi"}, 2);
+
+  // DNA needs two bits per character plus the samples
+  std::string dna(100000, 'A');
+  for (auto& c : dna) c = "ACGT"[gen() % 4];
+  FMIndex<> dna_fm(dna.begin(), dna.end());
+  assert (dna_fm.bytes() < dna.size());
+  assert (dna_fm.count(dna.substr(500, 20)) == 1);
+}
+
+template <typename Index>
+void check_external(const std::string& text, size_t memory_bytes)
+{
+  const std::string text_path = "test_external_text.tmp", sa_path = "test_external_sa.tmp";
+  std::ofstream(text_path, std::ios::binary | std::ios::trunc) << text;
+  assert (build_suffix_array_external<Index>(text_path, sa_path, memory_bytes) == text.size());
+
+  std::ifstream in(sa_path, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  auto expect = sais<Index>(text.begin(), text.end());
+  assert (bytes.size() == text.size() * index_traits<Index>::bytes);
+  sa_vector_t<Index> sa(text.size());
+  if (!bytes.empty()) std::memcpy(&sa[0], bytes.data(), bytes.size());
+  assert (sa == expect);
+  std::remove(text_path.c_str());
+  std::remove(sa_path.c_str());
+}
 
+template <>
+void check_external<uint40>(const std::string& text, size_t memory_bytes)
+{
+  const std::string text_path = "test_external_text.tmp", sa_path = "test_external_sa.tmp";
+  std::ofstream(text_path, std::ios::binary | std::ios::trunc) << text;
+  assert (build_suffix_array_external<uint40>(text_path, sa_path, memory_bytes) == text.size());
+
+  std::ifstream in(sa_path, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  auto expect = sais<uint40>(text.begin(), text.end());
+  assert (bytes.size() == text.size() * 5);
+  for (size_t i = 0; i < text.size(); i++) {
+    uint64_t v = 0;
+    for (size_t b = 0; b < 5; b++) v |= uint64_t(uint8_t(bytes[i * 5 + b])) << (8 * b);
+    assert (v == expect[i]);
+  }
+  std::remove(text_path.c_str());
+  std::remove(sa_path.c_str());
+}
+
+void test_external_suffix_array()
+{
+  std::mt19937 gen(37);
+  for (int alphabet : {1, 2, 4, 256}) {
+    std::string text(30000, 'a');
+    for (auto& c : text) c = static_cast<char>('a' + gen() % alphabet);
+    // 64 KiB forces many runs and multi pass merges, 16 MiB none
+    check_external<int>(text, 1 << 16);
+    check_external<int>(text, 1 << 24);
+  }
+
+  std::string prev("b"), fib("a");
+  while (fib.size() < 20000) {
+    auto next = fib + prev;
+    prev.swap(fib);
+    fib.swap(next);
+  }
+  check_external<int64_t>(fib, 1 << 16);
+  check_external<uint40>(fib.substr(0, 5000) + "\xff\0\0", 1 << 16);
+  for (auto s : {"", "a", "banana", "aaaaaaaaaaaaaaaaa", "abababababababababc"}) {
+    check_external<int>(s, 1 << 16);
+  }
+
+  bool thrown = false;
+  try {
+    build_suffix_array_external("missing_text.tmp", "test_external_sa.tmp", 1 << 20);
+  } catch (const std::system_error&) { thrown = true; }
+  assert (thrown);
+
+  thrown = false;
+  try {
+    build_suffix_array_external("missing_text.tmp", "test_external_sa.tmp", 1024);
+  } catch (const std::invalid_argument&) { thrown = true; }
+  assert (thrown);
+}
+
+int main() {
+  test_qsufsort_simple();
+  test_qsufsort_random();
+  test_sais();
+  test_build_suffix_array();
+  test_index_types();
+  test_lcp();
+  test_search();
+  test_index_file();
+  test_fm_index();
+  test_external_suffix_array();
   return 0;
 }
@@ -0,0 +1,72 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#if __cplusplus < 201103L
+  #error This header needs atleast a C++11 compliant compiler.
+#endif
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ds {
+
+/*
+ * @class MappedFile
+ * Read only memory mapping of a whole file. Pages are loaded on
+ * first touch; advice is the madvise hint for the access pattern,
+ * e.g MADV_SEQUENTIAL for a single scan, MADV_RANDOM for an index.
+ * Throws std::system_error if the file cannot be opened or mapped.
+ */
+class MappedFile
+{
+public:
+  explicit MappedFile(const std::string& path, int advice = MADV_SEQUENTIAL)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), path);
+
+    struct stat st;
+    if (::fstat(fd, &st) < 0) {
+      int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+
+    if (size_ > 0) {
+      void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::generic_category(), path);
+      }
+      data_ = static_cast<const char*>(addr);
+      ::madvise(addr, size_, advice);
+    }
+    ::close(fd);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  void operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (data_) ::munmap(const_cast<char*>(data_), size_);
+  }
+
+public:
+  const char* data() const noexcept { return data_; }
+  size_t size() const noexcept { return size_; }
+
+private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+}
+#endif
@@ -0,0 +1,159 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#if __cplusplus < 201103L
+  #error This header needs atleast a C++11 compliant compiler.
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ds {
+
+/*
+ * @class ThreadPool
+ * Fixed set of worker threads executing tasks from a shared queue.
+ * Meant for fork-join parallelism: a thread waiting on a forked task
+ * (wait/fork_join) runs queued tasks instead of blocking, so nested
+ * forks cannot starve the pool.
+ *
+ * Exposed API's:
+ * 1. submit(f)          - Queues f, returns a future of its result.
+ * 2. wait(future)       - Helps running tasks until future is ready.
+ * 3. fork_join(f, g)    - Runs f and g in parallel, returns when both are done.
+ * 4. parallel_for(first, last, f) - Calls f(begin, end) on disjoint
+ *    chunks of [first, last) and waits for all of them.
+ */
+class ThreadPool
+{
+public:
+  // Total parallelism is nthreads: the calling thread joins in
+  // while waiting, so nthreads - 1 workers are started.
+  explicit ThreadPool(size_t nthreads = std::thread::hardware_concurrency()):
+    nthreads_(std::max<size_t>(nthreads, 1))
+  {
+    for (size_t i = 1; i < nthreads_; i++) {
+      workers_.emplace_back([this] { worker_loop(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  void operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+    for (auto& w : workers_) w.join();
+  }
+
+public:
+  size_t size() const noexcept { return nthreads_; }
+
+  template <typename F>
+  auto submit(F&& f) -> std::future<decltype(f())>
+  {
+    using R = decltype(f());
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    auto fut = task->get_future();
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      queue_.emplace_back([task] { (*task)(); });
+    }
+    cond_.notify_one();
+    return fut;
+  }
+
+  template <typename T>
+  T wait(std::future<T>& fut)
+  {
+    while (fut.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      if (!run_one()) std::this_thread::yield();
+    }
+    return fut.get();
+  }
+
+  template <typename F, typename G>
+  void fork_join(F&& f, G&& g)
+  {
+    if (nthreads_ == 1) {
+      f();
+      g();
+      return;
+    }
+    auto fut = submit(std::forward<F>(f));
+    g();
+    wait(fut);
+  }
+
+  template <typename F>
+  void parallel_for(size_t first, size_t last, F&& f)
+  {
+    if (first >= last) return;
+    size_t chunks = std::min(last - first, nthreads_ * 4);
+    size_t step = (last - first + chunks - 1) / chunks;
+
+    std::vector<std::future<void>> futs;
+    for (size_t b = first + step; b < last; b += step) {
+      auto e = std::min(last, b + step);
+      futs.push_back(submit([&f, b, e] { f(b, e); }));
+    }
+    f(first, std::min(last, first + step));
+    for (auto& fut : futs) wait(fut);
+  }
+
+private:
+  // Runs one queued task if there is any
+  bool run_one()
+  {
+    std::function<void()> task;
+    {
+      std::lock_guard<std::mutex> lk(mutex_);
+      if (queue_.empty()) return false;
+      task = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    task();
+    return true;
+  }
+
+  void worker_loop()
+  {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lk(mutex_);
+        cond_.wait(lk, [this] { return stop_ || !queue_.empty(); });
+        if (stop_ && queue_.empty()) return;
+        task = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      task();
+    }
+  }
+
+private:
+  size_t nthreads_;
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> queue_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool stop_ = false;
+};
+
+}// end namespace ds
+
+#endif